@@ -1,15 +1,34 @@
+#ifdef __linux__
+#define _GNU_SOURCE	/* SEEK_DATA, SEEK_HOLE */
+#endif
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 #include <unistd.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <string.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
 #include <err.h>
 
 #include "audio.h"
+#include "caf.h"
 #include "pcm.h"
+#include "wav.h"
+
+#define MIN(x,y) ((x) < (y) ? (x) : (y))
+
+/* Silence shorter than this many bytes is not worth a hole. */
+#define SPARSEBLK 4096
+
+static int au_io_end(AUFILE*);
 
 struct {
 	char	suff[8];
@@ -18,6 +37,7 @@ struct {
 /* AU_FILETYPE_UNKNOWN	*/ { "",	""		},
 /* AU_FILETYPE_RAW	*/ { "raw",	"raw audio"	},
 /* AU_FILETYPE_WAV	*/ { "wav",	"wav audio"	},
+/* AU_FILETYPE_CAF	*/ { "caf",	"core audio"	},
 };
 
 AUFILETYPE
@@ -45,6 +65,47 @@ name2type(const char* path)
 	return suff2type(++suff);
 }
 
+/* Set the header reading/writing functions
+ * according to the file's type. Return 0 on success, -1 on error. */
+int
+au_init_type(AUFILE *file)
+{
+	switch (file->info->filetype) {
+		case AU_FILETYPE_RAW:
+			return 0;
+		case AU_FILETYPE_WAV:
+			return wav_init(file);
+		case AU_FILETYPE_CAF:
+			return caf_init(file);
+		default:
+			warnx("Unknown filetype of %s", file->path);
+			return -1;
+	}
+}
+
+/* Rewrite the header of a seekable file being written
+ * with the sizes of the data actually in the file.
+ * Return 0 on success, -1 on error. */
+static int
+au_fix_hdr(AUFILE *file)
+{
+	AUINFO info;
+	struct stat sb;
+	unsigned size;
+	if (au_io_end(file) == -1)
+		return -1;
+	if (file->hdr == NULL)
+		return 0;
+	if (fstat(file->fd, &sb) == -1 || !S_ISREG(sb.st_mode))
+		return -1;
+	info = *file->info;
+	size = (info.encoding & AU_BITSIZE_MASK) / 8;
+	info.samples = sb.st_size > file->data
+		? (sb.st_size - file->data) / size : 0;
+	info.frames = info.samples / info.channels;
+	return file->hdr->write(file->fd, &info);
+}
+
 AUFILE*
 au_open(const char* path, AUMODE mode, AUINFO* info)
 {
@@ -109,21 +170,16 @@ au_open(const char* path, AUMODE mode, AUINFO* info)
 	}
 	file->mode = mode;
 	file->path = strdup(path);
-	switch (info->filetype) {
-		case AU_FILETYPE_RAW:
-			break;
-		case AU_FILETYPE_WAV:
-			break;
-		default:
-			warnx("Unknown filetype of %s", path);
-			goto err;
-			break;
-	}
 	file->info = info;
-	/* FIXME: Set the header reading/writing functions */
-	if (file->mode == AU_READ) {
-		/* FIXME: When reading a known filetype, parse the header
-		* and fill info accordingly */
+	if (au_init_type(file))
+		goto err;
+	/* When reading a known filetype, parse the header
+	 * and fill info accordingly */
+	if (file->mode == AU_READ && file->hdr) {
+		if (file->hdr->read(file->fd, info)) {
+			warnx("Cannot read the header of '%s'", path);
+			goto err;
+		}
 	}
 	/* Set the sample reading/writing functions */
 	switch (info->encoding & AU_ENCTYPE_MASK) {
@@ -138,11 +194,23 @@ au_open(const char* path, AUMODE mode, AUINFO* info)
 			goto err;
 			break;
 	}
+	/* When writing, write the header now. */
 	if (file->mode == AU_WRITE) {
-		/* FIXME: when writing, write the header now. */
+		info->frames = info->samples = 0;
+		info->seconds = 0;
+		if (file->hdr && file->hdr->write(file->fd, info)) {
+			warnx("Cannot write the header of '%s'", path);
+			goto err;
+		}
 	}
+	/* Remember where the samples start. */
+	if ((file->data = lseek(file->fd, 0, SEEK_CUR)) == -1)
+		file->data = 0;
 	return file;
 err:
+	if (file->fd > STDERR_FILENO)
+		close(file->fd);
+	free(file->path);
 	free(file);
 	return NULL;
 }
@@ -167,6 +235,9 @@ print_encoding(uint32_t encoding)
 		case AU_ENCODING_FLOAT:
 			printf(", float");
 			break;
+		case AU_ENCODING_BFLOAT:
+			printf(", bfloat");
+			break;
 		default:
 			break;
 	}
@@ -221,109 +292,730 @@ au_info(AUFILE *f)
 	}
 }
 
+/* Rewrite the header of a file being written
+ * every given number of seconds of audio, so that
+ * the file is valid even if the recording never gets closed.
+ * The file must be seekable. Zero seconds stops the checkpoints.
+ * Return 0 on success, -1 on error. */
+int
+au_checkpoint(AUFILE *file, unsigned seconds)
+{
+	if (file == NULL || file->mode != AU_WRITE)
+		return -1;
+	if (seconds && lseek(file->fd, 0, SEEK_CUR) == -1) {
+		warnx("Cannot checkpoint '%s': %s", file->path, strerror(errno));
+		return -1;
+	}
+	file->every = (uint64_t)seconds * file->info->srate;
+	file->mark = file->info->frames;
+	return 0;
+}
+
+/* Repair the header of a file whose recording did not finish,
+ * so that it covers all the whole frames actually in the file.
+ * Return 0 on success, -1 on error. */
+int
+au_recover(const char *path)
+{
+	AUINFO info;
+	AUFILE file;
+	struct stat sb;
+	off_t len;
+	int ret = -1;
+
+	bzero(&info, sizeof(info));
+	bzero(&file, sizeof(file));
+	if ((info.filetype = name2type(path)) == AU_FILETYPE_UNKNOWN) {
+		warnx("Filetype of '%s' cannot be determined.", path);
+		return -1;
+	}
+	file.path = (char*) path;
+	file.mode = AU_WRITE;
+	file.info = &info;
+	if (au_init_type(&file))
+		return -1;
+	if (file.hdr == NULL)
+		return 0;
+	if ((file.fd = open(path, O_RDWR)) == -1) {
+		warnx("'%s': %s", path, strerror(errno));
+		return -1;
+	}
+	if (file.hdr->read(file.fd, &info)
+	|| (file.data = lseek(file.fd, 0, SEEK_CUR)) == -1
+	|| fstat(file.fd, &sb) == -1) {
+		warnx("Cannot read the header of '%s'", path);
+		goto done;
+	}
+	/* Drop the incomplete frame at the end, if any. */
+	len = info.channels * (info.encoding & AU_BITSIZE_MASK) / 8;
+	len = file.data + (sb.st_size - file.data) / len * len;
+	if (len < sb.st_size && ftruncate(file.fd, len) == -1)
+		goto done;
+	if (au_fix_hdr(&file) == 0)
+		ret = 0;
+done:
+	close(file.fd);
+	return ret;
+}
+
+/* How many frames are there in a file being read:
+ * as many as its header tells, or as the file holds. */
+uint64_t
+au_frames(AUFILE *file)
+{
+	struct stat sb;
+	size_t size;
+	if (file->hdr)
+		return file->info->frames;
+	if (fstat(file->fd, &sb) == -1 || sb.st_size <= file->data)
+		return 0;
+	size = file->info->channels
+		* (file->info->encoding & AU_BITSIZE_MASK) / 8;
+	return (sb.st_size - file->data) / size;
+}
+
+/* Open a part of a file, starting at the given frame, to be read
+ * or written independently of the file and its other parts:
+ * the part shares the file's descriptor but has its position
+ * of its own, and uses pread() and pwrite() at that position.
+ * E.g. several threads can each write their part of one file.
+ * Closing the part leaves the file open; closing a file being
+ * written fixes its header to cover the data of all its parts.
+ * The file must be seekable. Return NULL on error. */
+AUFILE*
+au_open_at(AUFILE *file, uint64_t frame)
+{
+	AUFILE *part;
+	size_t size;
+	if (file == NULL)
+		return NULL;
+	if (lseek(file->fd, 0, SEEK_CUR) == -1) {
+		warnx("Cannot open a part of '%s': %s",
+			file->path, strerror(errno));
+		return NULL;
+	}
+	if ((part = calloc(1, sizeof(AUFILE))) == NULL)
+		err(1, NULL);
+	*part = *file;
+	if ((part->info = malloc(sizeof(AUINFO))) == NULL
+	||  (part->path = strdup(file->path)) == NULL)
+		err(1, NULL);
+	*part->info = *file->info;
+	part->info->frames = part->info->samples = 0;
+	part->info->seconds = 0;
+	part->every = part->mark = 0;
+	part->probe = 0;
+	/* A part does not follow the file, nor watch it. */
+	part->follow = 0;
+	part->notify = 0;
+	part->parent = file;
+	size = part->info->channels
+		* (part->info->encoding & AU_BITSIZE_MASK) / 8;
+	part->pos = file->data + (off_t)frame * size;
+	/* Dither noise of its own, seeded by where the part starts,
+	 * so that parts written at once do not add the same noise. */
+	part->dither = (file->dither ? file->dither : 0x9e3779b9)
+		^ (uint32_t)(((frame + 1) * 0x9e3779b97f4a7c15ULL) >> 32);
+	if (part->dither == 0)
+		part->dither = 0x9e3779b9;
+	return part;
+}
+
+/* Open a region of a file being read, of nframes frames
+ * starting at the given frame: a part of the file which ends
+ * where the region does, and reads like a file of its own.
+ * A region is cheap, so that e.g. every clip referencing
+ * a source can have one. Return NULL on error. */
+AUFILE*
+au_open_region(AUFILE *file, uint64_t frame, uint64_t nframes)
+{
+	AUFILE *region;
+	AUINFO *info;
+	uint64_t frames;
+	size_t size;
+	if (file == NULL || file->mode != AU_READ || file->parent)
+		return NULL;
+	/* There are no frames past the end of the file. */
+	info = file->info;
+	frames = au_frames(file);
+	nframes = frame > frames ? 0 : MIN(nframes, frames - frame);
+	if ((region = au_open_at(file, frame)) == NULL)
+		return NULL;
+	size = info->channels * (info->encoding & AU_BITSIZE_MASK) / 8;
+	/* An empty region ends before it starts. */
+	region->end = nframes ? region->pos + (off_t)(nframes * size) : -1;
+	region->info->frames = nframes;
+	region->info->samples = nframes * info->channels;
+	region->info->seconds = (double) nframes / info->srate;
+	return region;
+}
+
+/* Read raw bytes of the file, at the position of a part,
+ * or the descriptor's own position. */
+static ssize_t
+au_io_get(AUFILE *file, void *buf, size_t len)
+{
+	ssize_t r;
+	if (file->parent == NULL)
+		return read(file->fd, buf, len);
+	if ((r = pread(file->fd, buf, len, file->pos)) > 0)
+		file->pos += r;
+	return r;
+}
+
+/* Write raw bytes into the file, at the position of a part,
+ * or the descriptor's own position. */
+static ssize_t
+au_io_put(AUFILE *file, const void *buf, size_t len)
+{
+	ssize_t w;
+	if (file->parent == NULL)
+		return write(file->fd, buf, len);
+	if ((w = pwrite(file->fd, buf, len, file->pos)) > 0)
+		file->pos += w;
+	return w;
+}
+
+/* The descriptor to look for the holes of the file on,
+ * or read its header again from. Either moves the descriptor's
+ * position, which a part shares with the file and its other parts,
+ * so a part uses another descriptor of the same file, of its own.
+ * Return -1 if there is none. */
+static int
+au_io_probe(AUFILE *file)
+{
+	struct stat a, b;
+	if (file->parent == NULL)
+		return file->fd;
+	if (file->probe)
+		return file->probe;
+	if ((file->probe = open(file->path, O_RDONLY)) == -1) {
+		file->probe = 0;
+	} else if (fstat(file->fd, &a) == -1 || fstat(file->probe, &b) == -1
+	|| a.st_dev != b.st_dev || a.st_ino != b.st_ino) {
+		close(file->probe);
+		file->probe = 0;
+	}
+	return file->probe ? file->probe : -1;
+}
+
+#ifdef SEEK_HOLE
+
+/* Read a sparse file: the holes in it read as zeros
+ * without any I/O, only the data gets actually read. */
+static ssize_t
+au_io_holes(AUFILE *file, unsigned char *buf, size_t len)
+{
+	struct stat sb;
+	off_t pos, next, start;
+	ssize_t r, tot = 0;
+	size_t n;
+	int fd;
+
+	/* Without a descriptor of its own, read the part as it is. */
+	if ((fd = au_io_probe(file)) == -1) {
+		file->sparse = 0;
+		return au_io_get(file, buf, len);
+	}
+	pos = file->parent ? file->pos : lseek(file->fd, 0, SEEK_CUR);
+	if ((start = pos) == -1)
+		return -1;
+	if (fstat(file->fd, &sb) == -1)
+		goto err;
+	while (len && pos < sb.st_size) {
+		if ((next = lseek(fd, pos, SEEK_DATA)) == -1) {
+			if (errno != ENXIO)
+				goto err;
+			/* A hole up to the end of the file. */
+			next = sb.st_size;
+		}
+		if (next > pos) {
+			n = MIN(len, (size_t)(next - pos));
+			memset(buf, 0, n);
+		} else {
+			if ((next = lseek(fd, pos, SEEK_HOLE)) == -1)
+				goto err;
+			n = MIN(len, (size_t)(next - pos));
+			if ((r = pread(file->fd, buf, n, pos)) == -1)
+				goto err;
+			if (r == 0)
+				break;
+			n = r;
+		}
+		pos += n;
+		buf += n;
+		len -= n;
+		tot += n;
+	}
+	if (file->parent)
+		file->pos = pos;
+	else if (lseek(file->fd, pos, SEEK_SET) == -1)
+		goto err;
+	return tot;
+err:
+	/* The probing moved the file's own descriptor:
+	 * leave it where the reading started. */
+	if (file->parent == NULL)
+		lseek(file->fd, start, SEEK_SET);
+	return -1;
+}
+#endif
+
+/* Milliseconds since some time. */
+static uint64_t
+au_io_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Wait for a file being followed to be written,
+ * for at most ms milliseconds: with inotify, which also tells
+ * when the writer closes the file, or by looking again after
+ * a while, from a millisecond to a tenth of a second.
+ * Return 1 if the writer has closed the file, 0 otherwise. */
+static int
+au_io_wait(AUFILE *file, unsigned ms, unsigned *tries)
+{
+	struct timespec ts = { 0, 0 };
+	unsigned nap;
+#ifdef __linux__
+	struct inotify_event ev;
+	struct pollfd pfd;
+
+	/* Take one event at a time, which the watch of a file has
+	 * no name in, so that the close stays queued behind the writes
+	 * before it until we have read what they wrote. */
+	if (file->notify) {
+		pfd.fd = file->notify;
+		pfd.events = POLLIN;
+		return poll(&pfd, 1, ms > INT_MAX ? INT_MAX : (int) ms) == 1
+			&& read(pfd.fd, &ev, sizeof(ev)) == sizeof(ev)
+			&& (ev.mask & IN_CLOSE_WRITE);
+	}
+#endif
+	nap = *tries < 7 ? 1U << (*tries)++ : 100;
+	nap = MIN(nap, ms);
+	ts.tv_sec = nap / 1000;
+	ts.tv_nsec = (nap % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+	return 0;
+}
+
+/* Update the sizes of a file being followed from its header,
+ * as the writer rewrites it, leaving the position where it was. */
+static void
+au_io_rehdr(AUFILE *file)
+{
+	AUINFO info;
+	off_t pos;
+	int fd;
+	if (file->hdr == NULL || (fd = au_io_probe(file)) == -1
+	||  (pos = lseek(fd, 0, SEEK_CUR)) == -1
+	||  lseek(fd, 0, SEEK_SET) == -1)
+		return;
+	bzero(&info, sizeof(info));
+	if (file->hdr->read(fd, &info) == 0) {
+		file->info->frames = info.frames;
+		file->info->samples = info.samples;
+		file->info->seconds = info.seconds;
+	}
+	lseek(fd, pos, SEEK_SET);
+}
+
+/* How many of len bytes of a file being followed can be read now:
+ * the whole frames written past our position, waiting for some
+ * to be written if there are none yet. The header is read again
+ * when the file has changed. Return 0 if nothing more got written
+ * for as long as we follow the file, or the writer has closed it;
+ * return -1 on error. */
+static ssize_t
+au_io_follow(AUFILE *file, size_t len)
+{
+	struct stat sb, last;
+	uint64_t now, until;
+	unsigned tries = 0;
+	size_t frame;
+	off_t pos;
+	int closed = 0;
+
+	frame = file->info->channels
+		* (file->info->encoding & AU_BITSIZE_MASK) / 8;
+	if ((pos = file->parent ? file->pos
+	: lseek(file->fd, 0, SEEK_CUR)) == -1)
+		return -1;
+	until = au_io_ms() + file->follow;
+	if (fstat(file->fd, &sb) == -1)
+		return -1;
+	while (sb.st_size - pos < (off_t)frame) {
+		if (closed || (now = au_io_ms()) >= until)
+			return 0;
+		closed = au_io_wait(file, until - now, &tries);
+		last = sb;
+		if (fstat(file->fd, &sb) == -1)
+			return -1;
+		/* The writer rewrites the header as it goes, and when done. */
+		if (closed || sb.st_size != last.st_size
+		||  sb.st_mtime != last.st_mtime)
+			au_io_rehdr(file);
+	}
+	return MIN(len, (size_t)((sb.st_size - pos) / frame * frame));
+}
+
+/* Read raw bytes of the file. This is what the reading
+ * routines use, e.g. pcm.c, to read the encoded samples. */
+ssize_t
+au_io_read(AUFILE *file, void *buf, size_t len)
+{
+	ssize_t n;
+	if (file->end)
+		len = file->pos < file->end
+			? MIN(len, (size_t)(file->end - file->pos)) : 0;
+	if (file->follow && len) {
+		if ((n = au_io_follow(file, len)) <= 0)
+			return n;
+		len = n;
+	}
+#ifdef SEEK_HOLE
+	if (file->sparse)
+		return au_io_holes(file, buf, len);
+#endif
+	return au_io_get(file, buf, len);
+}
+
+/* Is the buffer all zeros? */
+static int
+au_io_zero(const unsigned char *buf, size_t len)
+{
+	return buf[0] == 0 && memcmp(buf, buf + 1, len - 1) == 0;
+}
+
+/* Skip over silence being written, leaving a hole in the file. */
+static int
+au_io_skip(AUFILE *file, size_t len)
+{
+	if (file->parent) {
+		file->pos += len;
+		return 0;
+	}
+	return lseek(file->fd, len, SEEK_CUR) == -1 ? -1 : 0;
+}
+
+/* Make the file reach as far as we have written,
+ * even if that ends with a hole. Only ever extend the file,
+ * as the other parts may have written past us. */
+static int
+au_io_end(AUFILE *file)
+{
+	struct stat sb;
+	off_t end;
+	if (file->sparse == 0 || file->mode != AU_WRITE)
+		return 0;
+	end = file->parent ? file->pos : lseek(file->fd, 0, SEEK_CUR);
+	if (end == -1 || fstat(file->fd, &sb) == -1)
+		return -1;
+	if (sb.st_size < end && pwrite(file->fd, "", 1, end - 1) != 1)
+		return -1;
+	return 0;
+}
+
+/* Write raw bytes into the file. This is what the writing
+ * routines use to write the encoded samples. In a sparse file,
+ * blocks of silence are not written but skipped over. */
+ssize_t
+au_io_write(AUFILE *file, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	ssize_t w, tot = 0;
+	size_t n;
+	int zero;
+	if (file->sparse == 0)
+		return au_io_put(file, buf, len);
+	while (len) {
+		/* Find a run of blocks that are all silent, or all not. */
+		zero = au_io_zero(p, MIN(len, SPARSEBLK));
+		for (n = MIN(len, SPARSEBLK); n < len; n += SPARSEBLK)
+			if (au_io_zero(p + n, MIN(len - n, SPARSEBLK)) != zero)
+				break;
+		n = MIN(n, len);
+		if (zero) {
+			if (au_io_skip(file, n) == -1)
+				return -1;
+			w = n;
+		} else if ((w = au_io_put(file, p, n)) == -1)
+			return -1;
+		p += w;
+		len -= w;
+		tot += w;
+		if ((size_t)w < n)
+			break;
+	}
+	return tot;
+}
+
+/* Let the silence written into a file be holes in it,
+ * or let a sparse file being read skip reading its holes,
+ * when on is nonzero; or stop doing so. Only the encodings
+ * whose silence is all zero bytes can be written sparse.
+ * The file must be seekable. Return 0 on success, -1 on error. */
+int
+au_sparse(AUFILE *file, int on)
+{
+	if (file == NULL)
+		return -1;
+	if (on && file->mode == AU_WRITE && (file->info->encoding
+	& AU_ENCODING_MASK) == AU_ENCODING_UNSIGNED) {
+		warnx("Unsigned silence of '%s' is not zeros", file->path);
+		return -1;
+	}
+	if (on && lseek(file->fd, 0, SEEK_CUR) == -1) {
+		warnx("Cannot make '%s' sparse: %s",
+			file->path, strerror(errno));
+		return -1;
+	}
+	if (au_io_end(file) == -1)
+		return -1;
+	file->sparse = on;
+	return 0;
+}
+
+/* Follow a file being read while another process is still writing it:
+ * at the end of what has been written, wait for more to be written,
+ * for up to ms milliseconds, rather than end the reading at once;
+ * 0 stops following. The sizes in the header are updated as the
+ * writer rewrites them. The file must be a regular file.
+ * Return 0 on success, -1 on error. */
+int
+au_follow(AUFILE *file, unsigned ms)
+{
+	struct stat sb;
+#ifdef __linux__
+	int fd;
+#endif
+	if (file == NULL || file->mode != AU_READ)
+		return -1;
+	if (ms && (fstat(file->fd, &sb) == -1 || !S_ISREG(sb.st_mode))) {
+		warnx("Cannot follow '%s', not a regular file", file->path);
+		return -1;
+	}
+#ifdef __linux__
+	if (file->notify) {
+		close(file->notify);
+		file->notify = 0;
+	}
+	/* Watch it from now on, so that we miss nothing;
+	 * without inotify, we just look again after a while. */
+	if (ms && (fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) != -1) {
+		if (inotify_add_watch(fd, file->path,
+		IN_MODIFY|IN_CLOSE_WRITE) != -1)
+			file->notify = fd;
+		else
+			close(fd);
+	}
+#endif
+	file->follow = ms;
+	return 0;
+}
+
+/* Set how the file's integer samples get narrowed,
+ * e.g. when reading s32 samples as s16, or writing them into s8:
+ * the bits shifted out can be truncated, which is the default,
+ * rounded to the nearest, or dithered with triangular noise
+ * before rounding. Rounding saturates instead of wrapping around.
+ * Return 0 on success, -1 on error. */
+int
+au_rounding(AUFILE *file, AUROUND round)
+{
+	if (file == NULL)
+		return -1;
+	switch (round) {
+		case AU_ROUND_TRUNC:
+		case AU_ROUND_NEAREST:
+		case AU_ROUND_DITHER:
+			break;
+		default:
+			warnx("Unknown rounding %d", round);
+			return -1;
+	}
+	file->round = round;
+	if (file->dither == 0)
+		file->dither = 0x9e3779b9;
+	return 0;
+}
+
 int
 au_close(AUFILE *file)
 {
+	int ret = -1;
+	if (file && file->play)
+		return au_play_close(file);
+	if (file && file->parent) {
+		ret = au_io_end(file);
+		if (file->probe)
+			close(file->probe);
+		if (file->notify)
+			close(file->notify);
+		free(file->info);
+		free(file->path);
+		free(file);
+		return ret;
+	}
 	if (file) {
 		/*au_info(file);*/
 		if (file->fd) {
-			/* FIXME fix length in the header if we are writing
-			* and the file is seekable. */
-			return close(file->fd) == 0 ? 0 : -1;
+			/* Fix the length in the header if we are writing
+			 * and the file is seekable. */
+			if (file->mode == AU_WRITE
+			&& lseek(file->fd, 0, SEEK_CUR) != -1
+			&& au_fix_hdr(file) == -1)
+				warnx("Cannot fix the header of '%s'", file->path);
+			ret = close(file->fd) == 0 ? 0 : -1;
 		}
+		if (file->notify)
+			close(file->notify);
+		free(file->path);
+		free(file);
 	}
-	return -1;
+	return ret;
+}
+
+/* Account for n samples written,
+ * and checkpoint the header if it is time to. */
+static ssize_t
+au_wrote(AUFILE *file, ssize_t n)
+{
+	AUINFO *info = file->info;
+	if (n > 0) {
+		info->samples += n;
+		info->frames = info->samples / info->channels;
+		info->seconds = (double) info->frames / info->srate;
+		if (file->every && info->frames - file->mark >= file->every) {
+			if (au_fix_hdr(file) == -1)
+				warnx("Cannot checkpoint '%s'", file->path);
+			file->mark = info->frames;
+		}
+	}
+	return n;
 }
 
 ssize_t
 au_read_s8(AUFILE* file, int8_t* samples, size_t len)
 {
-	return file->au_read_s8(file->fd, samples, len);
+	return file->ops->read_s8(file, samples, len);
 }
 
 ssize_t
 au_write_s8(AUFILE* file, const int8_t* samples, size_t len)
 {
-	/* FIXME: Properly increment samples/frames elsewhere, too.
-	 * Should we take the number of _frames_ as argument?
-	 * Then the r/w functions would need more than a fd */
-	ssize_t n;
-	n = file->au_write_s8(file->fd, samples, len);
-	if (n >= 0) {
-		file->info->samples += n;
-		return n;
-	}
-	return -1;
+	return au_wrote(file, file->ops->write_s8(file, samples, len));
 }
 
 ssize_t
 au_read_u8(AUFILE* file, uint8_t* samples, size_t len)
 {
-	return file->au_read_u8(file->fd, samples, len);
+	return file->ops->read_u8(file, samples, len);
 }
 
 ssize_t
 au_write_u8(AUFILE* file, const uint8_t* samples, size_t len)
 {
-	return file->au_write_u8(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_u8(file, samples, len));
 }
 
 ssize_t
 au_read_s16(AUFILE* file, int16_t* samples, size_t len)
 {
-	return file->au_read_s16(file->fd, samples, len);
+	return file->ops->read_s16(file, samples, len);
 }
 
 ssize_t
 au_write_s16(AUFILE* file, const int16_t* samples, size_t len)
 {
-	return file->au_write_s16(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_s16(file, samples, len));
 }
 
 ssize_t
 au_read_u16(AUFILE* file, uint16_t* samples, size_t len)
 {
-	return file->au_read_u16(file->fd, samples, len);
+	return file->ops->read_u16(file, samples, len);
 }
 
 ssize_t
 au_write_u16(AUFILE* file, const uint16_t* samples, size_t len)
 {
-	return file->au_write_u16(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_u16(file, samples, len));
 }
 
 ssize_t
 au_read_s32(AUFILE* file, int32_t* samples, size_t len)
 {
-	return file->au_read_s32(file->fd, samples, len);
+	return file->ops->read_s32(file, samples, len);
 }
 
 ssize_t
 au_write_s32(AUFILE* file, const int32_t* samples, size_t len)
 {
-	return file->au_write_s32(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_s32(file, samples, len));
 }
 
 ssize_t
 au_read_u32(AUFILE* file, uint32_t* samples, size_t len)
 {
-	return file->au_read_u32(file->fd, samples, len);
+	return file->ops->read_u32(file, samples, len);
 }
 
 ssize_t
 au_write_u32(AUFILE* file, const uint32_t* samples, size_t len)
 {
-	return file->au_write_u32(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_u32(file, samples, len));
 }
 
 ssize_t
 au_read_f32(AUFILE* file, float* samples, size_t len)
 {
-	return file->au_read_f32(file->fd, samples, len);
+	return file->ops->read_f32(file, samples, len);
+}
+
+/* Read len samples as floats, and add them multiplied by gain
+ * into the samples already in acc, e.g. to mix several sources.
+ * Return the number of samples added, or -1 on error. */
+ssize_t
+au_read_accumulate_f32(AUFILE* file, float* acc, size_t len, float gain)
+{
+	if (file->mode != AU_READ)
+		return -1;
+	return file->ops->acc_f32(file, acc, len, gain);
 }
 
 ssize_t
 au_write_f32(AUFILE* file, const float* samples, size_t len)
 {
-	return file->au_write_f32(file->fd, samples, len);
+	return au_wrote(file, file->ops->write_f32(file, samples, len));
+}
+
+/* Q15 and Q31 fixed point samples, in [-1, 1). */
+
+ssize_t
+au_read_q15(AUFILE* file, int16_t* samples, size_t len)
+{
+	return file->ops->read_q15(file, samples, len);
+}
+
+ssize_t
+au_write_q15(AUFILE* file, const int16_t* samples, size_t len)
+{
+	return au_wrote(file, file->ops->write_q15(file, samples, len));
+}
+
+ssize_t
+au_read_q31(AUFILE* file, int32_t* samples, size_t len)
+{
+	return file->ops->read_q31(file, samples, len);
+}
+
+ssize_t
+au_write_q31(AUFILE* file, const int32_t* samples, size_t len)
+{
+	return au_wrote(file, file->ops->write_q31(file, samples, len));
 }
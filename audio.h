@@ -6,10 +6,11 @@
 #include <sys/stat.h>
 
 typedef enum {
-#define NUMTYPES 3
+#define NUMTYPES 4
 	AU_FILETYPE_UNKNOWN	= 0x0000,
 	AU_FILETYPE_RAW		= 0x0001,
-	AU_FILETYPE_WAV		= 0x0002
+	AU_FILETYPE_WAV		= 0x0002,
+	AU_FILETYPE_CAF		= 0x0003
 } AUFILETYPE;
 
 typedef enum {
@@ -17,6 +18,14 @@ typedef enum {
 	AU_WRITE		= 0x0001
 } AUMODE;
 
+/* How the bits shifted out are treated
+ * when narrowing integer samples, e.g. s32 to s16. */
+typedef enum {
+	AU_ROUND_TRUNC		= 0x0000,
+	AU_ROUND_NEAREST	= 0x0001,
+	AU_ROUND_DITHER		= 0x0002
+} AUROUND;
+
 /* The encoding is completely described in four bytes, specifying
  * the encoding type, the sample encoding, byteorder, and bitsize;
  * e.g. PCM, signed integers, little endian, 16 bits.
@@ -35,6 +44,7 @@ typedef enum {
 #define AU_ENCODING_SIGNED	0x00010000
 #define AU_ENCODING_UNSIGNED	0x00020000
 #define AU_ENCODING_FLOAT	0x00030000
+#define AU_ENCODING_BFLOAT	0x00040000
 
 #define AU_ORDER_NONE		0x00000000
 #define AU_ORDER_LE		0x00000100
@@ -42,49 +52,128 @@ typedef enum {
 
 typedef struct info {
 	AUFILETYPE	filetype;
-	uint16_t	srate;
+	uint32_t	srate;
 	uint32_t	encoding;
-	uint8_t		channels;
-	uint32_t	frames;
-	uint32_t	samples;
+	uint32_t	channels;
+	uint64_t	frames;
+	uint64_t	samples;
 	double		seconds;
 } AUINFO;
 
+struct aufile;
+
+/* No header is longer than this. */
+#define AU_HDRMAX	128
+
+/* The routines reading, writing and making in memory
+ * the header of a filetype. */
+typedef struct auhdr {
+	int		(*read) (int, AUINFO*);
+	int		(*write)(int, AUINFO*);
+	ssize_t		(*make) (AUINFO*, unsigned char*, size_t);
+} AUHDR;
+
+/* The routines reading and writing the samples of an encoding.
+ * These are shared by all the files in that encoding. */
+typedef struct auops {
+	ssize_t		(*read_s8)  (struct aufile*,         int8_t*, size_t);
+	ssize_t		(*read_u8)  (struct aufile*,        uint8_t*, size_t);
+	ssize_t		(*read_s16) (struct aufile*,        int16_t*, size_t);
+	ssize_t		(*read_u16) (struct aufile*,       uint16_t*, size_t);
+	ssize_t		(*read_s32) (struct aufile*,        int32_t*, size_t);
+	ssize_t		(*read_u32) (struct aufile*,       uint32_t*, size_t);
+	ssize_t		(*read_f32) (struct aufile*,          float*, size_t);
+	ssize_t		(*acc_f32)  (struct aufile*,   float*, size_t, float);
+	ssize_t		(*read_q15) (struct aufile*,        int16_t*, size_t);
+	ssize_t		(*read_q31) (struct aufile*,        int32_t*, size_t);
+
+	ssize_t		(*write_s8) (struct aufile*, const   int8_t*, size_t);
+	ssize_t		(*write_u8) (struct aufile*, const  uint8_t*, size_t);
+	ssize_t		(*write_s16)(struct aufile*, const  int16_t*, size_t);
+	ssize_t		(*write_u16)(struct aufile*, const uint16_t*, size_t);
+	ssize_t		(*write_s32)(struct aufile*, const  int32_t*, size_t);
+	ssize_t		(*write_u32)(struct aufile*, const uint32_t*, size_t);
+	ssize_t		(*write_f32)(struct aufile*, const    float*, size_t);
+	ssize_t		(*write_q15)(struct aufile*, const  int16_t*, size_t);
+	ssize_t		(*write_q31)(struct aufile*, const  int32_t*, size_t);
+} AUOPS;
+
 typedef struct aufile {
 	int		fd;
 	char*		path;
 	AUMODE		mode;
 	AUINFO		*info;
-
-	int		(*au_read_hdr) (int, AUINFO*);
-	int		(*au_write_hdr)(int, AUINFO*);
-
-	ssize_t		(*au_read_s8)  (int,         int8_t*, size_t);
-	ssize_t		(*au_read_u8)  (int,        uint8_t*, size_t);
-	ssize_t		(*au_read_s16) (int,        int16_t*, size_t);
-	ssize_t		(*au_read_u16) (int,       uint16_t*, size_t);
-	ssize_t		(*au_read_s32) (int,        int32_t*, size_t);
-	ssize_t		(*au_read_u32) (int,       uint32_t*, size_t);
-	ssize_t		(*au_read_f32) (int,          float*, size_t);
-
-	ssize_t		(*au_write_s8) (int, const   int8_t*, size_t);
-	ssize_t		(*au_write_u8) (int, const  uint8_t*, size_t);
-	ssize_t		(*au_write_s16)(int, const  int16_t*, size_t);
-	ssize_t		(*au_write_u16)(int, const uint16_t*, size_t);
-	ssize_t		(*au_write_s32)(int, const  int32_t*, size_t);
-	ssize_t		(*au_write_u32)(int, const uint32_t*, size_t);
-	ssize_t		(*au_write_f32)(int, const    float*, size_t);
+	const AUOPS	*ops;		/* the samples' routines */
+	const AUHDR	*hdr;		/* the header's, if any */
+	off_t		data;		/* where the samples start */
+	uint64_t	every;		/* frames between checkpoints */
+	uint64_t	mark;		/* frames at the last checkpoint */
+	struct aufile	*parent;	/* we are a part of this file */
+	off_t		pos;		/* where a part reads or writes */
+	off_t		end;		/* where a region ends, if nonzero */
+	int		sparse;		/* leave holes for silence */
+	int		probe;		/* a part's own fd to find holes with */
+	AUROUND		round;		/* how to narrow integer samples */
+	uint32_t	dither;		/* state of the dither noise */
+	struct auplay	*play;		/* we are a playlist of these */
+	unsigned	follow;		/* ms to wait for more at the end */
+	int		notify;		/* inotify watching it, if nonzero */
 } AUFILE;
 
+typedef struct augraph AUGRAPH;
+typedef ssize_t (*AUSTAGE)(void*, float*, size_t, size_t, int);
+
+typedef struct audyn AUDYN;
+typedef struct auvad AUVAD;
+typedef struct autempo AUTEMPO;
+typedef struct aupack AUPACK;
+
+/* A clip of a file in a playlist: its frames from in to out,
+ * or to the end of the file if out is 0, played with a gain. */
+typedef struct auclip {
+	const char	*path;
+	uint64_t	in;
+	uint64_t	out;
+	float		gain;
+} AUCLIP;
+
+/* A segment of an edit decision list: the frames of a file
+ * from in to out, or to its end if out is 0, with a gain,
+ * faded in and out over the given numbers of frames. */
+typedef struct auedit {
+	const char	*path;
+	uint64_t	in;
+	uint64_t	out;
+	float		gain;
+	uint64_t	fadein;
+	uint64_t	fadeout;
+} AUEDIT;
+
+/* A segment of speech found by AUVAD, in frames. */
+typedef struct auseg {
+	uint64_t	start;
+	uint64_t	end;
+} AUSEG;
 
 /* audio.c */
 AUFILETYPE suff2type	(const char*);
 AUFILETYPE name2type	(const char*);
 void	print_encoding	(uint32_t);
 
+int	au_init_type	(AUFILE*);
 AUFILE*	au_open		(const char*, AUMODE, AUINFO*);
 void	au_info		(AUFILE*);
 int	au_close	(AUFILE*);
+int	au_checkpoint	(AUFILE*, unsigned);
+uint64_t au_frames	(AUFILE*);
+AUFILE*	au_open_at	(AUFILE*, uint64_t);
+AUFILE*	au_open_region	(AUFILE*, uint64_t, uint64_t);
+ssize_t	au_io_read	(AUFILE*, void*, size_t);
+ssize_t	au_io_write	(AUFILE*, const void*, size_t);
+int	au_recover	(const char*);
+int	au_sparse	(AUFILE*, int);
+int	au_follow	(AUFILE*, unsigned);
+int	au_rounding	(AUFILE*, AUROUND);
 
 ssize_t	au_read_s8	(AUFILE*,         int8_t*, size_t);
 ssize_t	au_read_u8	(AUFILE*,        uint8_t*, size_t);
@@ -93,6 +182,9 @@ ssize_t	au_read_u16	(AUFILE*,       uint16_t*, size_t);
 ssize_t	au_read_s32	(AUFILE*,        int32_t*, size_t);
 ssize_t	au_read_u32	(AUFILE*,       uint32_t*, size_t);
 ssize_t	au_read_f32	(AUFILE*,          float*, size_t);
+ssize_t	au_read_accumulate_f32(AUFILE*,   float*, size_t, float);
+ssize_t	au_read_q15	(AUFILE*,        int16_t*, size_t);
+ssize_t	au_read_q31	(AUFILE*,        int32_t*, size_t);
 
 ssize_t	au_write_s8	(AUFILE*, const   int8_t*, size_t);
 ssize_t	au_write_u8	(AUFILE*, const  uint8_t*, size_t);
@@ -101,5 +193,62 @@ ssize_t	au_write_u16	(AUFILE*, const uint16_t*, size_t);
 ssize_t	au_write_s32	(AUFILE*, const  int32_t*, size_t);
 ssize_t	au_write_u32	(AUFILE*, const uint32_t*, size_t);
 ssize_t	au_write_f32	(AUFILE*, const    float*, size_t);
+ssize_t	au_write_q15	(AUFILE*, const  int16_t*, size_t);
+ssize_t	au_write_q31	(AUFILE*, const  int32_t*, size_t);
+
+/* pcm.c */
+void	au_swap_inplace	(void*, uint32_t, size_t);
+
+/* dyn.c */
+AUDYN*	au_dyn_open	(const AUINFO*, float, float, float, float, float, float);
+ssize_t	au_dyn		(AUDYN*, float*, size_t);
+ssize_t	au_dyn_drain	(AUDYN*, float*, size_t);
+void	au_dyn_close	(AUDYN*);
+
+/* vad.c */
+AUVAD*	au_vad_open	(const AUINFO*, float, float, float);
+size_t	au_vad_block	(const AUVAD*);
+ssize_t	au_vad		(AUVAD*, const int16_t*, size_t);
+ssize_t	au_vad_filter	(AUVAD*, int16_t*, size_t);
+void	au_vad_end	(AUVAD*);
+int	au_vad_segment	(AUVAD*, AUSEG*);
+void	au_vad_close	(AUVAD*);
+
+/* edl.c */
+ssize_t	au_edl_render	(AUFILE*, const AUEDIT*, size_t, unsigned);
+
+/* graph.c */
+AUGRAPH* au_graph_open	(AUFILE*, AUFILE*, size_t, size_t, size_t);
+int	au_graph_add	(AUGRAPH*, AUSTAGE, void*);
+ssize_t	au_graph_run	(AUGRAPH*);
+void	au_graph_close	(AUGRAPH*);
+
+/* pack.c */
+AUPACK*	au_pack_open	(const char*, AUMODE);
+int	au_pack_add	(AUPACK*, uint64_t, AUFILE*);
+int	au_pack_close	(AUPACK*);
+AUFILE*	au_open_packed	(AUPACK*, uint64_t);
+
+/* playlist.c */
+AUFILE*	au_play_open	(const AUCLIP*, size_t, size_t, AUINFO*);
+int	au_play_seek	(AUFILE*, uint64_t);
+int	au_play_close	(AUFILE*);
+
+/* serve.c */
+off_t	au_serve_size	(AUFILE*, AUFILETYPE);
+ssize_t	au_serve_range	(int, AUFILE*, AUFILETYPE, off_t, size_t);
+ssize_t	au_vread	(AUFILE*, AUFILETYPE, off_t, void*, size_t);
+off_t	au_transcode_size	(AUFILE*, AUFILETYPE, uint32_t);
+ssize_t	au_transcode_read	(AUFILE*, AUFILETYPE, uint32_t, off_t, void*, size_t);
+
+/* tee.c */
+ssize_t	au_tee		(AUFILE*, AUFILE**, size_t);
+
+/* tempo.c */
+AUTEMPO* au_tempo_open	(const AUINFO*, float);
+ssize_t	au_tempo_put	(AUTEMPO*, const float*, size_t);
+ssize_t	au_tempo_get	(AUTEMPO*, float*, size_t);
+void	au_tempo_end	(AUTEMPO*);
+void	au_tempo_close	(AUTEMPO*);
 
 #endif
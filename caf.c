@@ -0,0 +1,258 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <err.h>
+
+#include "audio.h"
+#include "caf.h"
+
+/* Apple's Core Audio Format. All numbers are big-endian.
+ * The file starts with a 'caff' header and consists of chunks,
+ * each with a 64 bit size. We write a 'desc' chunk describing
+ * the linear PCM format and a 'data' chunk with the samples.
+ * The data chunk is last and its size is written as -1, meaning
+ * "up to the end of the file", so the header never needs to be
+ * fixed up afterwards: a file being recorded is valid at any time,
+ * and can grow past 4GB. The samples are stored as they are,
+ * so the PCM routines read and write them directly. */
+
+#define CAF_FLOAT	(1 << 0)
+#define CAF_LE		(1 << 1)
+
+#define CAF_HDRSIZE	(8 + 12 + 32 + 12 + 4)
+
+static uint32_t
+rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	     | ((uint32_t)p[2] <<  8) | ((uint32_t)p[3] <<  0);
+}
+
+static uint64_t
+rd64(const unsigned char *p)
+{
+	return ((uint64_t)rd32(p) << 32) | rd32(p + 4);
+}
+
+static void
+wr32(unsigned char *p, uint32_t u)
+{
+	p[0] = u >> 24;
+	p[1] = u >> 16;
+	p[2] = u >>  8;
+	p[3] = u >>  0;
+}
+
+static void
+wr64(unsigned char *p, uint64_t u)
+{
+	wr32(p, u >> 32);
+	wr32(p + 4, u);
+}
+
+static int
+rdall(int fd, void *buf, size_t len)
+{
+	ssize_t r;
+	size_t tot = 0;
+	while (tot < len) {
+		if ((r = read(fd, (char*)buf + tot, len - tot)) <= 0)
+			return -1;
+		tot += r;
+	}
+	return 0;
+}
+
+/* Skip a chunk we do not care about; the file might not be seekable. */
+static int
+skip(int fd, uint64_t len)
+{
+	unsigned char buf[1024];
+	if (lseek(fd, len, SEEK_CUR) != -1)
+		return 0;
+	while (len) {
+		if (rdall(fd, buf, len < sizeof(buf) ? len : sizeof(buf)))
+			return -1;
+		len -= len < sizeof(buf) ? len : sizeof(buf);
+	}
+	return 0;
+}
+
+/* Read a CAF header from an open file and fill AUINFO accordingly,
+ * leaving the file positioned at the first sample.
+ * Values already present in AUINFO must agree with it.
+ * Return 0 for success, -1 on error. */
+int
+caf_read_hdr(int fd, AUINFO* info)
+{
+	unsigned char buf[32];
+	uint32_t encoding, flags, bits, chans;
+	uint64_t u, size, frames = 0;
+	struct stat sb;
+	off_t pos;
+	double srate = 0;
+	int desc = 0;
+
+	if (NULL == info)
+		return -1;
+	if (rdall(fd, buf, 8) || memcmp(buf, "caff", 4)) {
+		warnx("Not a CAF file");
+		return -1;
+	}
+	for (;;) {
+		if (rdall(fd, buf, 12)) {
+			warnx("No data in CAF file");
+			return -1;
+		}
+		size = rd64(buf + 4);
+		if (0 == memcmp(buf, "desc", 4)) {
+			if (size != 32 || rdall(fd, buf, 32))
+				return -1;
+			u = rd64(buf);
+			memcpy(&srate, &u, sizeof(srate));
+			flags = rd32(buf + 12);
+			chans = rd32(buf + 24);
+			bits  = rd32(buf + 28);
+			if (memcmp(buf + 8, "lpcm", 4) || rd32(buf + 20) != 1) {
+				warnx("Only linear PCM is supported in CAF");
+				return -1;
+			}
+			if (chans == 0 || bits == 0 || bits % 8
+			||  rd32(buf + 16) != chans * bits / 8) {
+				warnx("Packed samples are not supported in CAF");
+				return -1;
+			}
+			encoding = AU_ENCTYPE_PCM | bits;
+			encoding |= (flags & CAF_FLOAT)
+				? AU_ENCODING_FLOAT : AU_ENCODING_SIGNED;
+			if (bits > 8)
+				encoding |= (flags & CAF_LE)
+					? AU_ORDER_LE : AU_ORDER_BE;
+			desc = 1;
+		} else if (0 == memcmp(buf, "data", 4)) {
+			/* It starts with an edit count. */
+			if (size < 4 && size != UINT64_MAX) {
+				warnx("Broken CAF data chunk");
+				return -1;
+			}
+			if (rdall(fd, buf, 4))
+				return -1;
+			break;
+		} else if (skip(fd, size)) {
+			return -1;
+		}
+	}
+	if (!desc) {
+		warnx("No description of the CAF data");
+		return -1;
+	}
+	/* A size of -1 means the data go up to the end of the file. */
+	if (size != UINT64_MAX) {
+		frames = (size - 4) / (chans * bits / 8);
+	} else if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode)
+	&& (pos = lseek(fd, 0, SEEK_CUR)) != -1) {
+		frames = (sb.st_size - pos) / (chans * bits / 8);
+	}
+
+	/* The header says what the data are. */
+	if ((info->srate && info->srate != srate)
+	||  (info->channels && info->channels != chans)
+	||  (info->encoding && info->encoding != encoding)) {
+		warnx("The CAF file is not of the format given");
+		return -1;
+	}
+	info->srate = srate;
+	info->channels = chans;
+	info->encoding = encoding;
+	info->frames = frames;
+	info->samples = frames * chans;
+	info->seconds = srate ? frames / srate : 0;
+	return 0;
+}
+
+/* Make a CAF header as per AUINFO in buf, of size bytes.
+ * The data size is left unknown, so the header never changes.
+ * Return the length of the header, or -1 on error. */
+ssize_t
+caf_make_hdr(AUINFO* info, unsigned char *buf, size_t size)
+{
+	unsigned char *p = buf;
+	uint32_t bits, flags = 0;
+	uint64_t srate;
+	double d;
+
+	if (NULL == info || size < CAF_HDRSIZE)
+		return -1;
+	bits = info->encoding & AU_BITSIZE_MASK;
+	switch (info->encoding & AU_ENCODING_MASK) {
+		case AU_ENCODING_SIGNED:
+			break;
+		case AU_ENCODING_FLOAT:
+			flags |= CAF_FLOAT;
+			break;
+		default:
+			warnx("CAF only stores signed or float samples");
+			return -1;
+	}
+	if ((info->encoding & AU_ORDER_MASK) == AU_ORDER_LE)
+		flags |= CAF_LE;
+
+	memcpy(p, "caff", 4);
+	p[4] = 0; p[5] = 1;	/* version */
+	p[6] = 0; p[7] = 0;	/* flags */
+	p += 8;
+	memcpy(p, "desc", 4);
+	wr64(p + 4, 32);
+	p += 12;
+	d = info->srate;
+	memcpy(&srate, &d, sizeof(srate));
+	wr64(p, srate);
+	memcpy(p + 8, "lpcm", 4);
+	wr32(p + 12, flags);
+	wr32(p + 16, info->channels * bits / 8);
+	wr32(p + 20, 1);
+	wr32(p + 24, info->channels);
+	wr32(p + 28, bits);
+	p += 32;
+	memcpy(p, "data", 4);
+	wr64(p + 4, UINT64_MAX);
+	wr32(p + 12, 0);	/* edit count */
+	return CAF_HDRSIZE;
+}
+
+/* Write a CAF header as per AUINFO. If the file is already past it,
+ * it is rewritten in place with pwrite(), which does no harm.
+ * Return 0 for success, -1 on error. */
+int
+caf_write_hdr(int fd, AUINFO* info)
+{
+	unsigned char hdr[CAF_HDRSIZE];
+	off_t pos;
+
+	if (caf_make_hdr(info, hdr, sizeof(hdr)) == -1)
+		return -1;
+	if ((pos = lseek(fd, 0, SEEK_CUR)) <= 0) {
+		if (write(fd, hdr, sizeof(hdr)) != sizeof(hdr))
+			return -1;
+	} else if (pwrite(fd, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+		return -1;
+	}
+	return 0;
+}
+
+static const AUHDR caf_hdr = { caf_read_hdr, caf_write_hdr, caf_make_hdr };
+
+int
+caf_init(AUFILE *file)
+{
+	if (file == NULL || file->info == NULL)
+		return -1;
+	if (file->info->filetype != AU_FILETYPE_CAF) {
+		warnx("Will not intitialize non CAF file as CAF");
+		return -1;
+	}
+	file->hdr = &caf_hdr;
+	return 0;
+}
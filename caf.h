@@ -0,0 +1,8 @@
+#ifndef __AU_CAF_H_
+#define __AU_CAF_H_
+
+#include "audio.h"
+
+int caf_init(AUFILE *);
+
+#endif
@@ -0,0 +1,186 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Dynamic range compression and brickwall limiting of float samples,
+ * meant to be run between au_read_f32() and au_write_*().
+ * Every frame gets a single gain for all its channels,
+ * so that the stereo image does not wander.
+ *
+ * The incoming frames are delayed by the lookahead in a ring buffer.
+ * The gain needed by each frame in the ring is remembered,
+ * and the gain applied to the frame leaving the ring is smoothed
+ * towards the minimum of those, so the reduction is already there
+ * by the time a peak comes out. On top of that, the outgoing frame
+ * is never let above the ceiling, so nothing clips when the floats
+ * are converted to integers by the write routines. */
+
+struct audyn {
+	unsigned	channels;
+	float		thresh;		/* compressor threshold, linear */
+	float		slope;		/* 1 - 1/ratio */
+	float		ceiling;	/* limiter ceiling, linear */
+	float		attack;		/* per-frame smoothing coefficients */
+	float		release;
+	float		gain;		/* the smoothed gain */
+	size_t		size;		/* ring size in frames: lookahead + 1 */
+	size_t		pos;		/* where the next frame goes */
+	size_t		min;		/* where the smallest need is */
+	size_t		left;		/* delayed frames not drained yet */
+	float		*ring;		/* the delayed samples */
+	float		*need;		/* gain needed by each delayed frame */
+	float		*clip;		/* gain keeping it below the ceiling */
+};
+
+static float
+db2lin(float db)
+{
+	return powf(10.0, db / 20.0);
+}
+
+static float
+ms2coef(float ms, unsigned srate)
+{
+	if (ms <= 0)
+		return 0;
+	return expf(-1.0 / (ms / 1000.0 * srate));
+}
+
+/* Create a compressor/limiter for the format described by info.
+ * Above thresh (dBFS), the level is reduced by the given ratio;
+ * a ratio of 1 disables compression. Nothing ever exceeds
+ * the ceiling (dBFS). The attack, release and lookahead
+ * are in milliseconds. Return NULL on error. */
+AUDYN*
+au_dyn_open(const AUINFO *info, float thresh, float ratio,
+	float ceiling, float attack, float release, float lookahead)
+{
+	AUDYN *dyn;
+	size_t i;
+	if (info == NULL || info->channels == 0 || info->srate == 0)
+		return NULL;
+	if (ratio < 1.0) {
+		warnx("Compression ratio must be at least 1");
+		return NULL;
+	}
+	if (lookahead < 0) {
+		warnx("Lookahead cannot be negative");
+		return NULL;
+	}
+	if ((dyn = calloc(1, sizeof(AUDYN))) == NULL)
+		err(1, NULL);
+	dyn->channels = info->channels;
+	dyn->thresh  = db2lin(thresh);
+	dyn->slope   = 1.0 - 1.0 / ratio;
+	dyn->ceiling = db2lin(ceiling);
+	dyn->attack  = ms2coef(attack, info->srate);
+	dyn->release = ms2coef(release, info->srate);
+	dyn->gain    = 1.0;
+	dyn->size    = 1 + lookahead / 1000.0 * info->srate;
+	if ((dyn->ring = calloc(dyn->size * dyn->channels, sizeof(float))) == NULL
+	||  (dyn->need = calloc(dyn->size, sizeof(float))) == NULL
+	||  (dyn->clip = calloc(dyn->size, sizeof(float))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < dyn->size; i++)
+		dyn->need[i] = dyn->clip[i] = 1.0;
+	return dyn;
+}
+
+void
+au_dyn_close(AUDYN *dyn)
+{
+	if (dyn) {
+		free(dyn->ring);
+		free(dyn->need);
+		free(dyn->clip);
+		free(dyn);
+	}
+}
+
+/* Push one frame into the ring, and pull the oldest one out,
+ * with the gain applied. The frame is processed in place. */
+static void
+dyn_frame(AUDYN *dyn, float *frame)
+{
+	unsigned c;
+	size_t i, out;
+	float peak = 0, need, gain, tmp, *slot;
+
+	for (c = 0; c < dyn->channels; c++)
+		if ((tmp = fabsf(frame[c])) > peak)
+			peak = tmp;
+	need = 1.0;
+	if (peak > dyn->thresh && dyn->slope > 0)
+		need = powf(dyn->thresh / peak, dyn->slope);
+	dyn->clip[dyn->pos] = peak > dyn->ceiling ? dyn->ceiling / peak : 1.0;
+	if (dyn->clip[dyn->pos] < need)
+		need = dyn->clip[dyn->pos];
+	dyn->need[dyn->pos] = need;
+
+	/* Keep track of the smallest need in the ring;
+	 * only rescan when the smallest one has just been overwritten. */
+	if (dyn->min == dyn->pos) {
+		for (i = 0; i < dyn->size; i++)
+			if (dyn->need[i] < dyn->need[dyn->min])
+				dyn->min = i;
+	} else if (need <= dyn->need[dyn->min]) {
+		dyn->min = dyn->pos;
+	}
+
+	need = dyn->need[dyn->min];
+	tmp = need < dyn->gain ? dyn->attack : dyn->release;
+	dyn->gain = need + tmp * (dyn->gain - need);
+
+	/* Swap the new frame for the oldest one. */
+	out = (dyn->pos + 1) % dyn->size;
+	gain = dyn->clip[out] < dyn->gain ? dyn->clip[out] : dyn->gain;
+	slot = dyn->ring + dyn->pos * dyn->channels;
+	for (c = 0; c < dyn->channels; c++)
+		slot[c] = frame[c];
+	slot = dyn->ring + out * dyn->channels;
+	for (c = 0; c < dyn->channels; c++)
+		frame[c] = slot[c] * gain;
+	dyn->pos = out;
+}
+
+/* Process len interleaved samples in place. The output is delayed
+ * by the lookahead; the first frames coming out are silence.
+ * Return the number of samples processed, or -1 on error. */
+ssize_t
+au_dyn(AUDYN *dyn, float *samples, size_t len)
+{
+	size_t i;
+	if (dyn == NULL || samples == NULL)
+		return -1;
+	if (len % dyn->channels) {
+		warnx("%zu samples is not a whole number of frames", len);
+		return -1;
+	}
+	for (i = 0; i < len; i += dyn->channels)
+		dyn_frame(dyn, samples + i);
+	dyn->left += len / dyn->channels;
+	if (dyn->left > dyn->size - 1)
+		dyn->left = dyn->size - 1;
+	return len;
+}
+
+/* Get the frames still delayed in the lookahead ring
+ * once there is no more input. Return the number of samples
+ * stored into samples, 0 if there are no more, or -1 on error. */
+ssize_t
+au_dyn_drain(AUDYN *dyn, float *samples, size_t len)
+{
+	size_t i = 0;
+	if (dyn == NULL || samples == NULL)
+		return -1;
+	for (; dyn->left && i + dyn->channels <= len; i += dyn->channels) {
+		memset(samples + i, 0, dyn->channels * sizeof(float));
+		dyn_frame(dyn, samples + i);
+		dyn->left--;
+	}
+	return i;
+}
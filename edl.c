@@ -0,0 +1,251 @@
+#ifdef __linux__
+#define _GNU_SOURCE	/* copy_file_range() */
+#endif
+#include <sys/types.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Render an edit decision list: a list of segments of source files,
+ * with gains and fades, put one after another into an output file.
+ * Every segment is planned first: where it comes from, where it goes
+ * in the output, and whether it needs any processing at all.
+ * A segment of the output's encoding, with no gain and no fades,
+ * is the same bytes in the output as in the source, so it is just
+ * copied, with copy_file_range() where there is one, which can share
+ * the blocks or at least copy them within the kernel. The other
+ * segments are read as floats, processed, and written through a part
+ * of the output at their place in it. The segments are independent,
+ * so a pool of threads renders them, each taking the next one left. */
+
+#define EDLBLOCK (16 * 1024)
+#define EDLCOPY  (64 * 1024)
+#define MIN(x,y) ((x) < (y) ? (x) : (y))
+
+struct seg {
+	const AUEDIT	*edit;
+	uint64_t	len;		/* in frames */
+	uint64_t	start;		/* in the output */
+	int		copy;		/* the bytes can be copied */
+};
+
+struct edl {
+	AUFILE		*dst;
+	struct seg	*segs;
+	size_t		nsegs;
+	_Atomic size_t	next;		/* the segment to render next */
+	_Atomic int	error;
+};
+
+/* Open the source of an edit, as a file of the output's format
+ * if it is RAW. Return NULL on error. */
+static AUFILE*
+edl_open(AUFILE *dst, const AUEDIT *edit, AUINFO *info)
+{
+	AUFILE *src;
+	/* Only a RAW file takes its format from info. */
+	bzero(info, sizeof(AUINFO));
+	if (name2type(edit->path) == AU_FILETYPE_RAW) {
+		info->srate = dst->info->srate;
+		info->channels = dst->info->channels;
+		info->encoding = dst->info->encoding;
+	}
+	if ((src = au_open(edit->path, AU_READ, info)) == NULL)
+		return NULL;
+	if (info->srate != dst->info->srate
+	||  info->channels != dst->info->channels) {
+		warnx("Cannot resample or remix '%s' into '%s'",
+			edit->path, dst->path);
+		au_close(src);
+		return NULL;
+	}
+	return src;
+}
+
+/* Copy len bytes from src at soff into dst at doff.
+ * Return 0 on success, -1 on error. */
+static int
+edl_copy(int src, off_t soff, int dst, off_t doff, size_t len)
+{
+	unsigned char buf[EDLCOPY];
+	ssize_t r, w;
+#ifdef __linux__
+	while (len) {
+		if ((r = copy_file_range(src, &soff, dst, &doff, len, 0)) == -1)
+			break;
+		if (r == 0)
+			return -1;
+		len -= r;
+	}
+	if (len == 0)
+		return 0;
+	/* Not between these two files: copy it ourselves. */
+	if (errno != EXDEV && errno != EINVAL
+	&&  errno != ENOSYS && errno != EOPNOTSUPP)
+		return -1;
+#endif
+	while (len) {
+		if ((r = pread(src, buf, MIN(len, sizeof(buf)), soff)) <= 0)
+			return -1;
+		if ((w = pwrite(dst, buf, r, doff)) != r)
+			return -1;
+		soff += r;
+		doff += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/* Read the segment as floats, apply the gain and the fades,
+ * and write it at its place in the output.
+ * Return 0 on success, -1 on error. */
+static int
+edl_process(AUFILE *dst, AUFILE *src, const struct seg *s)
+{
+	const AUEDIT *e = s->edit;
+	unsigned ch = dst->info->channels;
+	AUFILE *region, *part;
+	float buf[EDLBLOCK], *b, g;
+	uint64_t f, frame = 0;
+	size_t blk = EDLBLOCK / ch * ch;
+	ssize_t r;
+	int ret = -1;
+	unsigned c;
+
+	if ((region = au_open_region(src, e->in, s->len)) == NULL)
+		return -1;
+	if ((part = au_open_at(dst, s->start)) == NULL) {
+		au_close(region);
+		return -1;
+	}
+	while ((r = au_read_f32(region, buf, blk)) > 0) {
+		for (b = buf; b < buf + r; b += ch, frame++) {
+			g = e->gain;
+			if (frame < e->fadein)
+				g *= (float) frame / e->fadein;
+			f = s->len - frame;
+			if (f <= e->fadeout)
+				g *= (float) (f - 1) / e->fadeout;
+			for (c = 0; c < ch; c++)
+				b[c] *= g;
+		}
+		if (au_write_f32(part, buf, r) != r)
+			goto done;
+	}
+	if (r == 0)
+		ret = 0;
+done:
+	au_close(region);
+	if (au_close(part))
+		ret = -1;
+	return ret;
+}
+
+static void*
+edl_work(void *arg)
+{
+	struct edl *edl = arg;
+	struct seg *s;
+	AUINFO info;
+	AUFILE *src;
+	size_t i, size;
+	off_t soff, doff;
+	int ret;
+	while ((i = atomic_fetch_add(&edl->next, 1)) < edl->nsegs) {
+		if (atomic_load(&edl->error))
+			break;
+		s = &edl->segs[i];
+		if (s->len == 0)
+			continue;
+		if ((src = edl_open(edl->dst, s->edit, &info)) == NULL) {
+			atomic_store(&edl->error, 1);
+			break;
+		}
+		size = info.channels * (info.encoding & AU_BITSIZE_MASK) / 8;
+		soff = src->data + (off_t)(s->edit->in * size);
+		doff = edl->dst->data + (off_t)(s->start * size);
+		ret = s->copy
+			? edl_copy(src->fd, soff, edl->dst->fd, doff, s->len * size)
+			: edl_process(edl->dst, src, s);
+		if (ret == -1) {
+			warnx("Cannot render '%s' into '%s'",
+				s->edit->path, edl->dst->path);
+			atomic_store(&edl->error, 1);
+		}
+		au_close(src);
+	}
+	return NULL;
+}
+
+/* Render the n edits into dst, which must be a seekable file
+ * being written, using nthreads threads.
+ * Return the number of frames rendered, or -1 on error. */
+ssize_t
+au_edl_render(AUFILE *dst, const AUEDIT *edits, size_t n, unsigned nthreads)
+{
+	struct edl edl;
+	struct seg *s;
+	pthread_t *threads;
+	AUINFO info;
+	AUFILE *src;
+	uint64_t frames, start = 0;
+	size_t i;
+
+	if (dst == NULL || dst->mode != AU_WRITE || dst->parent
+	||  edits == NULL || nthreads == 0)
+		return -1;
+	if (lseek(dst->fd, 0, SEEK_CUR) == -1) {
+		warnx("Cannot render into '%s', not seekable", dst->path);
+		return -1;
+	}
+	/* A frame has to fit into a block being processed. */
+	if (dst->info->channels > EDLBLOCK) {
+		warnx("Cannot render into '%s', too many channels", dst->path);
+		return -1;
+	}
+
+	/* Plan every segment. */
+	if ((edl.segs = calloc(n, sizeof(struct seg))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < n; i++) {
+		s = &edl.segs[i];
+		s->edit = &edits[i];
+		if ((src = edl_open(dst, s->edit, &info)) == NULL) {
+			free(edl.segs);
+			return -1;
+		}
+		frames = au_frames(src);
+		if (s->edit->out && s->edit->out < frames)
+			frames = s->edit->out;
+		s->len = frames > s->edit->in ? frames - s->edit->in : 0;
+		s->start = start;
+		s->copy = info.encoding == dst->info->encoding
+			&& s->edit->gain == 1
+			&& s->edit->fadein == 0 && s->edit->fadeout == 0;
+		start += s->len;
+		au_close(src);
+	}
+
+	/* Render them. */
+	edl.dst = dst;
+	edl.nsegs = n;
+	atomic_init(&edl.next, 0);
+	atomic_init(&edl.error, 0);
+	if ((threads = calloc(nthreads, sizeof(pthread_t))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, edl_work, &edl))
+			err(1, NULL);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	free(edl.segs);
+	return atomic_load(&edl.error) ? -1 : (ssize_t)start;
+}
@@ -0,0 +1,315 @@
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* A pipeline running a read -> process -> write chain,
+ * with every stage in a thread of its own. The reader reads float
+ * blocks from an AUFILE, the processors modify them in place one
+ * after another, and the writer writes them into another AUFILE.
+ * The blocks come from a fixed pool and are passed between
+ * the stages by pointer through bounded single-producer,
+ * single-consumer queues, which need no locks;
+ * the writer gives the blocks back to the reader.
+ * A block has room for more samples than are read into it,
+ * so that a processor can make it longer, e.g. when resampling up.
+ * At the end of the input, the reader sends empty last blocks for as
+ * long as it gets blocks back. A processor is called with each of
+ * them to drain what it still holds, and sends the ones it drained
+ * into on as ordinary blocks; once it has nothing more, it sends
+ * the last blocks on as they are. A last block making it to the
+ * writer thus means every processor is done: the writer sends it
+ * around once more as done, and every stage stops as it passes. */
+
+struct block {
+	float		*samples;
+	ssize_t		len;		/* samples in the block */
+	int		last;		/* the end of the input */
+	int		done;		/* the writer has got everything */
+};
+
+struct queue {
+	_Atomic size_t	head;		/* where to get the next block */
+	_Atomic size_t	tail;		/* where to put the next block */
+	size_t		size;
+	struct block	**ring;
+};
+
+struct stage {
+	AUGRAPH		*graph;
+	AUSTAGE		func;
+	void		*arg;
+	struct queue	*in;
+	struct queue	*out;
+	pthread_t	thread;
+	int		drained;	/* nothing more to drain */
+};
+
+struct augraph {
+	AUFILE		*src;
+	AUFILE		*dst;
+	size_t		blocklen;	/* samples read into a block */
+	size_t		maxlen;		/* room in a block */
+	size_t		nblocks;
+	struct block	*blocks;
+	struct stage	*stages;	/* the processors */
+	size_t		nstages;
+	_Atomic int	error;
+	uint64_t	total;		/* samples read */
+};
+
+/* Wait for the other end of a queue: spin for a while,
+ * then yield the CPU, then sleep for longer and longer. */
+static void
+backoff(unsigned *tries)
+{
+	struct timespec ts = { 0, 0 };
+	if (++*tries < 64)
+		return;
+	if (*tries < 128) {
+		sched_yield();
+		return;
+	}
+	ts.tv_nsec = 1000L << (*tries < 138 ? *tries - 128 : 10);
+	nanosleep(&ts, NULL);
+}
+
+static void
+queue_init(struct queue *q, size_t size)
+{
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	q->size = size;
+	if ((q->ring = calloc(size, sizeof(struct block*))) == NULL)
+		err(1, NULL);
+}
+
+static void
+queue_put(struct queue *q, struct block *b)
+{
+	unsigned tries = 0;
+	size_t t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	while (t - atomic_load_explicit(&q->head, memory_order_acquire)
+	== q->size)
+		backoff(&tries);
+	q->ring[t % q->size] = b;
+	atomic_store_explicit(&q->tail, t + 1, memory_order_release);
+}
+
+static struct block*
+queue_get(struct queue *q)
+{
+	unsigned tries = 0;
+	struct block *b;
+	size_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+	while (atomic_load_explicit(&q->tail, memory_order_acquire) == h)
+		backoff(&tries);
+	b = q->ring[h % q->size];
+	atomic_store_explicit(&q->head, h + 1, memory_order_release);
+	return b;
+}
+
+/* Create a pipeline reading float blocks of blocklen samples from src
+ * and writing them into dst, using at most nblocks blocks at a time,
+ * each with room for maxlen samples. Return NULL on error. */
+AUGRAPH*
+au_graph_open(AUFILE *src, AUFILE *dst,
+	size_t blocklen, size_t maxlen, size_t nblocks)
+{
+	AUGRAPH *graph;
+	size_t i;
+	if (src == NULL || dst == NULL || src->mode != AU_READ
+	|| dst->mode != AU_WRITE || blocklen == 0 || maxlen < blocklen
+	|| nblocks < 2)
+		return NULL;
+	if ((graph = calloc(1, sizeof(AUGRAPH))) == NULL)
+		err(1, NULL);
+	graph->src = src;
+	graph->dst = dst;
+	graph->blocklen = blocklen;
+	graph->maxlen = maxlen;
+	graph->nblocks = nblocks;
+	if ((graph->blocks = calloc(nblocks, sizeof(struct block))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < nblocks; i++)
+		if ((graph->blocks[i].samples
+		= calloc(maxlen, sizeof(float))) == NULL)
+			err(1, NULL);
+	atomic_init(&graph->error, 0);
+	return graph;
+}
+
+/* Append a processor to the chain. It is called with each block
+ * of len samples, which it modifies in place, with room for max;
+ * it returns the number of samples in the block (at most max),
+ * or -1 on error. At the end of the input, it is called with last
+ * set and an empty block, again and again, to drain what it still
+ * holds into the blocks, until it returns 0.
+ * Return 0 on success, -1 on error. */
+int
+au_graph_add(AUGRAPH *graph, AUSTAGE func, void *arg)
+{
+	struct stage *s;
+	if (graph == NULL || func == NULL)
+		return -1;
+	s = reallocarray(graph->stages, graph->nstages + 1, sizeof(*s));
+	if (s == NULL)
+		err(1, NULL);
+	graph->stages = s;
+	s += graph->nstages++;
+	s->graph = graph;
+	s->func = func;
+	s->arg = arg;
+	return 0;
+}
+
+static void*
+graph_read(void *arg)
+{
+	struct stage *s = arg;
+	AUGRAPH *graph = s->graph;
+	struct block *b;
+	int end = 0;
+	for (;;) {
+		b = queue_get(s->in);
+		if (b->done)
+			break;
+		b->len = end || atomic_load(&graph->error) ? 0
+			: au_read_f32(graph->src, b->samples, graph->blocklen);
+		if (b->len < 0) {
+			atomic_store(&graph->error, 1);
+			b->len = 0;
+		}
+		graph->total += b->len;
+		b->last = end = b->len == 0;
+		queue_put(s->out, b);
+	}
+	queue_put(s->out, b);
+	return NULL;
+}
+
+static void*
+graph_process(void *arg)
+{
+	struct stage *s = arg;
+	AUGRAPH *graph = s->graph;
+	struct block *b;
+	ssize_t len;
+	do {
+		b = queue_get(s->in);
+		if (!b->done && !s->drained && (b->len > 0 || b->last)) {
+			len = s->func(s->arg, b->samples, b->len,
+				graph->maxlen, b->last);
+			if (len < 0 || (size_t)len > graph->maxlen) {
+				atomic_store(&graph->error, 1);
+				len = 0;
+			}
+			b->len = len;
+			if (b->last) {
+				/* Drained into: not the last block yet. */
+				if (len > 0)
+					b->last = 0;
+				else
+					s->drained = 1;
+			}
+		}
+		queue_put(s->out, b);
+	} while (!b->done);
+	return NULL;
+}
+
+static void*
+graph_write(void *arg)
+{
+	struct stage *s = arg;
+	AUGRAPH *graph = s->graph;
+	struct block *b;
+	int sent = 0;
+	for (;;) {
+		b = queue_get(s->in);
+		if (b->done)
+			break;
+		if (b->len > 0
+		&& au_write_f32(graph->dst, b->samples, b->len) != b->len)
+			atomic_store(&graph->error, 1);
+		if (b->last && !sent)
+			b->done = sent = 1;
+		queue_put(s->out, b);
+	}
+	return NULL;
+}
+
+/* Run the pipeline until all of the input has been read,
+ * processed and written. Return the number of samples read,
+ * or -1 on error. */
+ssize_t
+au_graph_run(AUGRAPH *graph)
+{
+	struct stage rd, wr;
+	struct queue *q;
+	size_t i, n;
+
+	if (graph == NULL)
+		return -1;
+	n = graph->nstages + 2;
+	if ((q = calloc(n, sizeof(struct queue))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < n; i++)
+		queue_init(&q[i], graph->nblocks);
+	/* All the blocks are free to be read into at first. */
+	for (i = 0; i < graph->nblocks; i++) {
+		graph->blocks[i].last = graph->blocks[i].done = 0;
+		queue_put(&q[0], &graph->blocks[i]);
+	}
+	for (i = 0; i < graph->nstages; i++)
+		graph->stages[i].drained = 0;
+	graph->total = 0;
+	atomic_store(&graph->error, 0);
+
+	rd.graph = graph;
+	rd.in  = &q[0];
+	rd.out = &q[1];
+	for (i = 0; i < graph->nstages; i++) {
+		graph->stages[i].in  = &q[i + 1];
+		graph->stages[i].out = &q[i + 2];
+	}
+	wr.graph = graph;
+	wr.in  = &q[n - 1];
+	wr.out = &q[0];
+
+	if (pthread_create(&rd.thread, NULL, graph_read, &rd)
+	||  pthread_create(&wr.thread, NULL, graph_write, &wr))
+		err(1, NULL);
+	for (i = 0; i < graph->nstages; i++)
+		if (pthread_create(&graph->stages[i].thread, NULL,
+		graph_process, &graph->stages[i]))
+			err(1, NULL);
+
+	pthread_join(rd.thread, NULL);
+	for (i = 0; i < graph->nstages; i++)
+		pthread_join(graph->stages[i].thread, NULL);
+	pthread_join(wr.thread, NULL);
+
+	for (i = 0; i < n; i++)
+		free(q[i].ring);
+	free(q);
+	return atomic_load(&graph->error) ? -1 : (ssize_t)graph->total;
+}
+
+void
+au_graph_close(AUGRAPH *graph)
+{
+	size_t i;
+	if (graph) {
+		for (i = 0; i < graph->nblocks; i++)
+			free(graph->blocks[i].samples);
+		free(graph->blocks);
+		free(graph->stages);
+		free(graph);
+	}
+}
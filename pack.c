@@ -0,0 +1,383 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+#include "audio.h"
+#include "pcm.h"
+
+/* A pack of many short clips in one file, so that reading a clip
+ * costs no open() of its own, and no inode. The clips are stored
+ * back to back in their own encodings, after a header:
+ *
+ *	"AUPACK\0\0"	magic
+ *	uint32_t	version
+ *	uint32_t	reserved
+ *	uint64_t	number of clips
+ *	uint64_t	where the index starts
+ *
+ * The index follows the clips, sorted by the clips' ids:
+ *
+ *	uint64_t	id
+ *	uint64_t	where the clip starts
+ *	uint64_t	frames
+ *	uint32_t	sample rate
+ *	uint32_t	channels
+ *	uint32_t	encoding
+ *	uint32_t	reserved
+ *
+ * All numbers are big-endian. A pack being read has its index mapped
+ * into memory and searched in place; a clip is opened as a region of
+ * the pack, read with pread(). A pack being built takes clips from
+ * several threads at once: each gets its place at the end under
+ * a lock, and is copied there with pwrite() outside of it. The index
+ * is sorted and written when the pack is closed. */
+
+#define PACK_MAGIC	"AUPACK\0\0"
+#define PACK_VERSION	1
+#define PACK_HDRSIZE	32
+#define PACK_ENTSIZE	40
+#define PACKBUF		(64 * 1024)
+#define MIN(x,y) ((x) < (y) ? (x) : (y))
+
+struct packent {
+	uint64_t	id;
+	uint64_t	off;
+	uint64_t	frames;
+	uint32_t	srate;
+	uint32_t	channels;
+	uint32_t	encoding;
+};
+
+struct aupack {
+	AUFILE		file;		/* the clips are parts of this */
+	/* reading */
+	unsigned char	*map;
+	size_t		maplen;
+	const unsigned char *index;
+	uint64_t	count;
+	/* writing */
+	pthread_mutex_t	lock;
+	struct packent	*ents;
+	size_t		nents;
+	size_t		maxents;
+	uint64_t	end;		/* where the next clip goes */
+	int		error;
+};
+
+static uint32_t
+rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	     | ((uint32_t)p[2] <<  8) | ((uint32_t)p[3] <<  0);
+}
+
+static uint64_t
+rd64(const unsigned char *p)
+{
+	return ((uint64_t)rd32(p) << 32) | rd32(p + 4);
+}
+
+static void
+wr32(unsigned char *p, uint32_t u)
+{
+	p[0] = u >> 24;
+	p[1] = u >> 16;
+	p[2] = u >>  8;
+	p[3] = u >>  0;
+}
+
+static void
+wr64(unsigned char *p, uint64_t u)
+{
+	wr32(p, u >> 32);
+	wr32(p + 4, u);
+}
+
+static int
+pack_hdr(AUPACK *pack, uint64_t count, uint64_t index)
+{
+	unsigned char hdr[PACK_HDRSIZE];
+	memcpy(hdr, PACK_MAGIC, 8);
+	wr32(hdr + 8, PACK_VERSION);
+	wr32(hdr + 12, 0);
+	wr64(hdr + 16, count);
+	wr64(hdr + 24, index);
+	return pwrite(pack->file.fd, hdr, sizeof(hdr), 0) == sizeof(hdr)
+		? 0 : -1;
+}
+
+/* Map the index of a pack being read. Return 0 on success, -1 on error. */
+static int
+pack_index(AUPACK *pack)
+{
+	unsigned char hdr[PACK_HDRSIZE];
+	uint64_t index;
+	struct stat sb;
+	off_t base;
+
+	if (pread(pack->file.fd, hdr, sizeof(hdr), 0) != sizeof(hdr)
+	||  memcmp(hdr, PACK_MAGIC, 8) || rd32(hdr + 8) != PACK_VERSION) {
+		warnx("'%s' is not a pack of clips", pack->file.path);
+		return -1;
+	}
+	pack->count = rd64(hdr + 16);
+	index = rd64(hdr + 24);
+	if (fstat(pack->file.fd, &sb) == -1
+	||  index < PACK_HDRSIZE || index > (uint64_t)sb.st_size
+	||  pack->count > ((uint64_t)sb.st_size - index) / PACK_ENTSIZE) {
+		warnx("The index of '%s' is broken", pack->file.path);
+		return -1;
+	}
+	if (pack->count == 0)
+		return 0;
+	base = index - index % sysconf(_SC_PAGESIZE);
+	pack->maplen = index - base + pack->count * PACK_ENTSIZE;
+	pack->map = mmap(NULL, pack->maplen, PROT_READ, MAP_SHARED,
+		pack->file.fd, base);
+	if (pack->map == MAP_FAILED) {
+		pack->map = NULL;
+		warn("%s", pack->file.path);
+		return -1;
+	}
+	pack->index = pack->map + (index - base);
+	return 0;
+}
+
+/* Open a pack of clips to be read, or to be built.
+ * Return NULL on error. */
+AUPACK*
+au_pack_open(const char *path, AUMODE mode)
+{
+	AUPACK *pack;
+	int flags;
+	if (path == NULL || (mode != AU_READ && mode != AU_WRITE))
+		return NULL;
+	if ((pack = calloc(1, sizeof(AUPACK))) == NULL
+	||  (pack->file.path = strdup(path)) == NULL)
+		err(1, NULL);
+	pack->file.mode = mode;
+	flags = mode == AU_READ ? O_RDONLY : O_RDWR|O_CREAT|O_TRUNC;
+	if ((pack->file.fd = open(path, flags, 0644)) == -1) {
+		warnx("'%s': %s", path, strerror(errno));
+		free(pack->file.path);
+		free(pack);
+		return NULL;
+	}
+	if (mode == AU_READ) {
+		if (pack_index(pack) == 0)
+			return pack;
+	} else {
+		pthread_mutex_init(&pack->lock, NULL);
+		pack->end = PACK_HDRSIZE;
+		/* Not a valid pack until it is closed. */
+		if (pack_hdr(pack, 0, 0) == 0)
+			return pack;
+		pthread_mutex_destroy(&pack->lock);
+	}
+	close(pack->file.fd);
+	free(pack->file.path);
+	free(pack);
+	return NULL;
+}
+
+/* Add a clip of the given id to a pack being built:
+ * all of a file being read, or all of a region of one.
+ * This can be called from several threads at once.
+ * Return 0 on success, -1 on error. */
+int
+au_pack_add(AUPACK *pack, uint64_t id, AUFILE *src)
+{
+	unsigned char buf[PACKBUF];
+	struct packent *e;
+	uint64_t frames, off, len, done;
+	off_t from;
+	ssize_t r;
+
+	if (pack == NULL || pack->file.mode != AU_WRITE
+	||  src == NULL || src->mode != AU_READ)
+		return -1;
+	/* A part other than a region does not know its length. */
+	if (src->parent && src->end == 0) {
+		warnx("Cannot add a part of '%s' to '%s', only a region",
+			src->path, pack->file.path);
+		return -1;
+	}
+	frames = src->parent ? src->info->frames : au_frames(src);
+	len = frames * src->info->channels
+		* (src->info->encoding & AU_BITSIZE_MASK) / 8;
+	/* A region ends where it did, wherever it has been read up to. */
+	from = src->parent ? src->end - (off_t)len : src->data;
+
+	pthread_mutex_lock(&pack->lock);
+	if (pack->nents == pack->maxents) {
+		pack->maxents = pack->maxents ? 2 * pack->maxents : 1024;
+		e = reallocarray(pack->ents, pack->maxents, sizeof(*e));
+		if (e == NULL)
+			err(1, NULL);
+		pack->ents = e;
+	}
+	e = &pack->ents[pack->nents++];
+	e->id = id;
+	e->off = off = pack->end;
+	e->frames = frames;
+	e->srate = src->info->srate;
+	e->channels = src->info->channels;
+	e->encoding = src->info->encoding;
+	pack->end += len;
+	pthread_mutex_unlock(&pack->lock);
+
+	for (done = 0; done < len; done += r) {
+		r = pread(src->fd, buf, MIN(len - done, sizeof(buf)),
+			from + done);
+		if (r <= 0 || pwrite(pack->file.fd, buf, r, off + done) != r) {
+			warnx("Cannot add '%s' to '%s'",
+				src->path, pack->file.path);
+			pthread_mutex_lock(&pack->lock);
+			pack->error = 1;
+			pthread_mutex_unlock(&pack->lock);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+pack_cmp(const void *a, const void *b)
+{
+	const struct packent *x = a, *y = b;
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* Sort the index of a pack being built and write it after the clips,
+ * then the header saying where it is. Return 0 on success, -1 on error. */
+static int
+pack_finish(AUPACK *pack)
+{
+	unsigned char *buf, *ent;
+	off_t at = pack->end;
+	size_t i, len;
+	if (pack->error)
+		return -1;
+	qsort(pack->ents, pack->nents, sizeof(struct packent), pack_cmp);
+	for (i = 1; i < pack->nents; i++)
+		if (pack->ents[i].id == pack->ents[i - 1].id) {
+			warnx("Clip %" PRIu64 " is in '%s' twice",
+				pack->ents[i].id, pack->file.path);
+			return -1;
+		}
+	if ((buf = malloc(PACKBUF)) == NULL)
+		err(1, NULL);
+	for (i = 0, len = 0; i < pack->nents; i++) {
+		ent = buf + len;
+		wr64(ent +  0, pack->ents[i].id);
+		wr64(ent +  8, pack->ents[i].off);
+		wr64(ent + 16, pack->ents[i].frames);
+		wr32(ent + 24, pack->ents[i].srate);
+		wr32(ent + 28, pack->ents[i].channels);
+		wr32(ent + 32, pack->ents[i].encoding);
+		wr32(ent + 36, 0);
+		len += PACK_ENTSIZE;
+		if (len + PACK_ENTSIZE > PACKBUF || i + 1 == pack->nents) {
+			if (pwrite(pack->file.fd, buf, len, at) != (ssize_t)len) {
+				free(buf);
+				return -1;
+			}
+			at += len;
+			len = 0;
+		}
+	}
+	free(buf);
+	return pack_hdr(pack, pack->nents, pack->end);
+}
+
+/* Close a pack. A pack being built gets its index written;
+ * the clips opened from a pack being read must be closed before.
+ * Return 0 on success, -1 on error. */
+int
+au_pack_close(AUPACK *pack)
+{
+	int ret = 0;
+	if (pack == NULL)
+		return -1;
+	if (pack->file.mode == AU_WRITE) {
+		if ((ret = pack_finish(pack)) == -1)
+			warnx("Cannot finish '%s'", pack->file.path);
+		pthread_mutex_destroy(&pack->lock);
+		free(pack->ents);
+	}
+	if (pack->map)
+		munmap(pack->map, pack->maplen);
+	if (close(pack->file.fd) == -1)
+		ret = -1;
+	free(pack->file.path);
+	free(pack);
+	return ret;
+}
+
+/* Open the clip of the given id in a pack being read:
+ * a region of the pack, which reads like a RAW file of its own.
+ * Return NULL if there is no such clip, or on error. */
+AUFILE*
+au_open_packed(AUPACK *pack, uint64_t id)
+{
+	const unsigned char *e = NULL;
+	uint64_t lo, hi, mid, eid, frames;
+	AUFILE *file;
+	AUINFO *info;
+	size_t size;
+
+	if (pack == NULL || pack->file.mode != AU_READ)
+		return NULL;
+	for (lo = 0, hi = pack->count; lo < hi; ) {
+		mid = lo + (hi - lo) / 2;
+		eid = rd64(pack->index + mid * PACK_ENTSIZE);
+		if (eid == id) {
+			e = pack->index + mid * PACK_ENTSIZE;
+			break;
+		}
+		if (eid < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (e == NULL)
+		return NULL;
+
+	if ((file = calloc(1, sizeof(AUFILE))) == NULL
+	||  (info = calloc(1, sizeof(AUINFO))) == NULL
+	||  (file->path = strdup(pack->file.path)) == NULL)
+		err(1, NULL);
+	frames = rd64(e + 16);
+	info->filetype = AU_FILETYPE_RAW;
+	info->srate = rd32(e + 24);
+	info->channels = rd32(e + 28);
+	info->encoding = rd32(e + 32);
+	info->frames = frames;
+	info->samples = frames * info->channels;
+	info->seconds = info->srate ? (double) frames / info->srate : 0;
+	size = info->channels * (info->encoding & AU_BITSIZE_MASK) / 8;
+	file->fd = pack->file.fd;
+	file->mode = AU_READ;
+	file->info = info;
+	file->parent = &pack->file;
+	file->data = file->pos = rd64(e + 8);
+	/* An empty clip ends before it starts. */
+	file->end = frames ? file->pos + (off_t)(frames * size) : -1;
+	if (pcm_init(file)) {
+		warnx("Cannot read clip %" PRIu64 " of '%s'",
+			id, pack->file.path);
+		free(info);
+		free(file->path);
+		free(file);
+		return NULL;
+	}
+	return file;
+}
@@ -1,6 +1,7 @@
 #include <inttypes.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <err.h>
 
@@ -83,48 +84,262 @@ RFBE(unsigned char* p)
 #define WFLE(p,s) { ufloat uf; uf.f = s; W32LE(p, uf.u); }
 #define WFBE(p,s) { ufloat uf; uf.f = s; W32BE(p, uf.u); }
 
+/* Narrowing routines, from wider to narrower integer samples.
+ * The bits shifted out are truncated, rounded to the nearest,
+ * or dithered first with triangular noise of one narrow LSB,
+ * as set with au_rounding(). The rounding can go over the top,
+ * so the result is saturated then. */
+
+static inline int32_t
+DITHER(AUFILE *file, int shift)
+{
+	uint32_t r1, r2, mask = ((uint32_t)1 << shift) - 1;
+	r1 = file->dither;
+	r1 ^= r1 << 13; r1 ^= r1 >> 17; r1 ^= r1 << 5;
+	r2 = r1;
+	r2 ^= r2 << 13; r2 ^= r2 >> 17; r2 ^= r2 << 5;
+	file->dither = r2;
+	return (int32_t)(r1 & mask) + (int32_t)(r2 & mask) - (int32_t)mask;
+}
+
+static inline int32_t
+NARROW(AUFILE *file, int32_t s, int from, int to)
+{
+	int shift = from - to;
+	int64_t v = s, max = ((int64_t)1 << (to - 1)) - 1;
+	if (file->round == AU_ROUND_TRUNC)
+		return s >> shift;
+	v += (int64_t)1 << (shift - 1);
+	if (file->round == AU_ROUND_DITHER)
+		v += DITHER(file, shift);
+	v >>= shift;
+	return v > max ? max : v < -max - 1 ? -max - 1 : v;
+}
+
+/* Fixed point routines. Q15 and Q31 samples are the signed
+ * 16 and 32 bit integers scaled by 2^15 and 2^31, which is
+ * what the integer encodings read and write as s16 and s32 are.
+ * Floats are scaled by a power of two, rounded and saturated. */
+
+static inline int16_t
+Q15(float f)
+{
+	double v = f * 32768.0;
+	if (v >= INT16_MAX)
+		return INT16_MAX;
+	if (v <= INT16_MIN)
+		return INT16_MIN;
+	return v < 0 ? v - 0.5 : v + 0.5;
+}
+
+static inline int32_t
+Q31(float f)
+{
+	double v = f * 2147483648.0;
+	if (v >= INT32_MAX)
+		return INT32_MAX;
+	if (v <= INT32_MIN)
+		return INT32_MIN;
+	return v < 0 ? v - 0.5 : v + 0.5;
+}
+
+/* Sign flipping routines, between signed and unsigned samples
+ * of the same size. The unsigned bias is just the top bit flipped,
+ * so it is done with an xor, together with the byte order conversion,
+ * in one pass simple enough for the compiler to vectorize.
+ * The flipping get routines work in place: the caller's buffer
+ * is read into directly, and converted into native samples. */
+
+static inline void
+FLIP16LE(uint16_t *s, size_t n)
+{
+	unsigned char *p = (unsigned char*) s;
+	size_t i;
+	for (i = 0; i < n; i++, p += 2)
+		s[i] = (uint16_t)R16LE(p) ^ 0x8000;
+}
+
+static inline void
+FLIP16BE(uint16_t *s, size_t n)
+{
+	unsigned char *p = (unsigned char*) s;
+	size_t i;
+	for (i = 0; i < n; i++, p += 2)
+		s[i] = (uint16_t)R16BE(p) ^ 0x8000;
+}
+
+static inline void
+FLIP32LE(uint32_t *s, size_t n)
+{
+	unsigned char *p = (unsigned char*) s;
+	size_t i;
+	for (i = 0; i < n; i++, p += 4)
+		s[i] = ((uint32_t)p[0] <<  0 | (uint32_t)p[1] <<  8
+		|       (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24) ^ 0x80000000;
+}
+
+static inline void
+FLIP32BE(uint32_t *s, size_t n)
+{
+	unsigned char *p = (unsigned char*) s;
+	size_t i;
+	for (i = 0; i < n; i++, p += 4)
+		s[i] = ((uint32_t)p[3] <<  0 | (uint32_t)p[2] <<  8
+		|       (uint32_t)p[1] << 16 | (uint32_t)p[0] << 24) ^ 0x80000000;
+}
+
+#define PUTFLIP(W, bits) {					\
+	size_t _i;						\
+	for (_i = 0; _i < n; _i++, p += bits / 8)		\
+		W(p, s[_i] ^ ((uint##bits##_t)1 << (bits - 1)));	\
+}
+
+static inline void
+PUTFLIP16LE(unsigned char *p, const uint16_t *s, size_t n)
+PUTFLIP(W16LE, 16)
+
+static inline void
+PUTFLIP16BE(unsigned char *p, const uint16_t *s, size_t n)
+PUTFLIP(W16BE, 16)
+
+static inline void
+PUTFLIP32LE(unsigned char *p, const uint32_t *s, size_t n)
+PUTFLIP(W32LE, 32)
+
+static inline void
+PUTFLIP32BE(unsigned char *p, const uint32_t *s, size_t n)
+PUTFLIP(W32BE, 32)
+
+
+/* Byte order routines, for samples of the same type and size
+ * as in the file, just possibly in the other byte order.
+ * These are read straight into the caller's buffer and swapped
+ * in place, or written straight from it when no swap is needed. */
+
+static uint32_t
+NATIVE(void)
+{
+	const uint16_t one = 1;
+	return *(const unsigned char*) &one ? AU_ORDER_LE : AU_ORDER_BE;
+}
+
+/* Convert n samples between the byte order of the encoding
+ * and the native one, in place. Either way it is the same swap. */
+void
+au_swap_inplace(void *buf, uint32_t encoding, size_t n)
+{
+	unsigned char t, *p = buf;
+	size_t i;
+	if ((encoding & AU_ORDER_MASK) == AU_ORDER_NONE
+	||  (encoding & AU_ORDER_MASK) == NATIVE())
+		return;
+	switch (encoding & AU_BITSIZE_MASK) {
+	case 16:
+		for (i = 0; i < n; i++, p += 2) {
+			t = p[0]; p[0] = p[1]; p[1] = t;
+		}
+		break;
+	case 24:
+		for (i = 0; i < n; i++, p += 3) {
+			t = p[0]; p[0] = p[2]; p[2] = t;
+		}
+		break;
+	case 32:
+		for (i = 0; i < n; i++, p += 4) {
+			t = p[0]; p[0] = p[3]; p[3] = t;
+			t = p[1]; p[1] = p[2]; p[2] = t;
+		}
+		break;
+	case 64:
+		for (i = 0; i < n; i++, p += 8) {
+			t = p[0]; p[0] = p[7]; p[7] = t;
+			t = p[1]; p[1] = p[6]; p[6] = t;
+			t = p[2]; p[2] = p[5]; p[5] = t;
+			t = p[3]; p[3] = p[4]; p[4] = t;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static ssize_t
+pcm_read_same(AUFILE *file, void *samples, size_t len, size_t size)
+{
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * size)) == -1)
+		err(1, NULL);
+	r /= size;
+	au_swap_inplace(samples, file->info->encoding, r);
+	return r;
+}
+
+static ssize_t
+pcm_write_same(AUFILE *file, const void *samples, size_t len, size_t size)
+{
+	ssize_t w, buflen, tot = 0;
+	const unsigned char *s = samples;
+	unsigned char buf[BUFSIZE * 4];
+	if ((file->info->encoding & AU_ORDER_MASK) == NATIVE()) {
+		if ((w = au_io_write(file, samples, len * size)) == -1)
+			err(1, NULL);
+		return w / size;
+	}
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		memcpy(buf, s, buflen * size);
+		au_swap_inplace(buf, file->info->encoding, buflen);
+		if ((w = au_io_write(file, buf, buflen * size)) == -1)
+			err(1, NULL);
+		s += buflen * size;
+		len -= buflen;
+		tot += w / size;
+	}
+	return tot;
+}
+
 
 /* int8_t */
 
 static ssize_t
-pcm_read_s8_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_s8_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t r = 0;
-	if ((r = read(fd, samples, len)) == -1)
+	if ((r = au_io_read(file, samples, len)) == -1)
 		err(1, NULL);
 	return r;
 }
 
 static ssize_t
-pcm_write_s8_as_s8(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_s8(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t w = 0;
-	if ((w = write(fd, samples, len)) == -1)
+	if ((w = au_io_write(file, samples, len)) == -1)
 		err(1, NULL);
 	return w;
 }
 
 static ssize_t
-pcm_read_s8_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_s8_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r;
-	if ((r = read(fd, samples, len)) == -1)
+	if ((r = au_io_read(file, samples, len)) == -1)
 		err(1, NULL);
 	for (i = 0; i < r ; i++)
-		samples[i] += 0x80;
+		samples[i] ^= 0x80;
 	return r;
 }
 
 static ssize_t
-pcm_write_s8_as_u8(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_u8(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen; i++)
-			buf[i] = *samples++ + 0x80;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = *samples++ ^ 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -133,14 +348,16 @@ pcm_write_s8_as_u8(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s8_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_s8_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = buf[i] << 8;
 		len -= r;
@@ -150,7 +367,7 @@ pcm_read_s8_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_s16le(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_s16le(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -158,7 +375,7 @@ pcm_write_s8_as_s16le(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16LE(p, *samples++ << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -167,7 +384,7 @@ pcm_write_s8_as_s16le(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_s16be(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_s16be(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -175,7 +392,7 @@ pcm_write_s8_as_s16be(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16BE(p, *samples++ << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -184,14 +401,16 @@ pcm_write_s8_as_s16be(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s8_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_s8_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = (buf[i] + 0x80) << 8;
 		len -= r;
@@ -201,7 +420,7 @@ pcm_read_s8_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_u16le(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_u16le(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -209,7 +428,7 @@ pcm_write_s8_as_u16le(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16LE(p, (*samples++ + 0x80) << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -218,7 +437,7 @@ pcm_write_s8_as_u16le(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_u16be(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_u16be(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -226,7 +445,7 @@ pcm_write_s8_as_u16be(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16BE(p, (*samples++ + 0x80) << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -235,14 +454,16 @@ pcm_write_s8_as_u16be(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s8_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_s8_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = buf[i] << 24;
 		len -= r;
@@ -252,7 +473,7 @@ pcm_read_s8_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_s32le(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_s32le(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -260,7 +481,7 @@ pcm_write_s8_as_s32le(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, *samples++ << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -269,7 +490,7 @@ pcm_write_s8_as_s32le(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_s32be(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_s32be(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -277,7 +498,7 @@ pcm_write_s8_as_s32be(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, *samples++ << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -286,14 +507,16 @@ pcm_write_s8_as_s32be(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s8_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_s8_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = (buf[i] + 0x80) << 24;
 		len -= r;
@@ -303,7 +526,7 @@ pcm_read_s8_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_u32le(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_u32le(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -311,7 +534,7 @@ pcm_write_s8_as_u32le(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, (*samples++ + 0x80) << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -320,7 +543,7 @@ pcm_write_s8_as_u32le(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_u32be(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_u32be(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -328,7 +551,7 @@ pcm_write_s8_as_u32be(int fd, const int8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, (*samples++ + 0x80) << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -337,14 +560,16 @@ pcm_write_s8_as_u32be(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s8_as_f32(int fd, float *samples, size_t len)
+pcm_read_s8_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = buf[i] > 0
 				? ( 1.0 * buf[i]) / INT8_MAX
@@ -356,7 +581,7 @@ pcm_read_s8_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_f32le(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_f32le(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -366,7 +591,7 @@ pcm_write_s8_as_f32le(int fd, const int8_t *samples, size_t len)
 			WFLE(p, *samples > 0
 				? (*samples *  1.0) / INT8_MAX
 				: (*samples * -1.0) / INT8_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -375,7 +600,7 @@ pcm_write_s8_as_f32le(int fd, const int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s8_as_f32be(int fd, const int8_t *samples, size_t len)
+pcm_write_s8_as_f32be(AUFILE *file, const int8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -385,7 +610,7 @@ pcm_write_s8_as_f32be(int fd, const int8_t *samples, size_t len)
 			WFLE(p, *samples > 0
 				? (*samples *  1.0) / INT8_MAX
 				: (*samples * -1.0) / INT8_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -396,26 +621,26 @@ pcm_write_s8_as_f32be(int fd, const int8_t *samples, size_t len)
 /* uint8_t */
 
 static ssize_t
-pcm_read_u8_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_u8_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, n;
-	if ((n = read(fd, samples, len)) == -1)
+	if ((n = au_io_read(file, samples, len)) == -1)
 		err(1, NULL);
 	for (i = 0; i < n ; i++)
-		samples[i] -= 0x80;
+		samples[i] ^= 0x80;
 	return n;
 }
 
 static ssize_t
-pcm_write_u8_as_s8(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_s8(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen; i++)
-			buf[i] = *samples++ - 0x80;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = *samples++ ^ 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -424,32 +649,34 @@ pcm_write_u8_as_s8(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u8_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_u8_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t n;
-	if ((n = read(fd, samples, len)) == -1)
+	if ((n = au_io_read(file, samples, len)) == -1)
 		err(1, NULL);
 	return n;
 }
 
 static ssize_t
-pcm_write_u8_as_u8(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_u8(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t n;
-	if ((n = write(fd, samples, len)) == -1)
+	if ((n = au_io_write(file, samples, len)) == -1)
 		err(1, NULL);
 	return n;
 }
 
 static ssize_t
-pcm_read_u8_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_u8_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = (buf[i] - 0x80) << 8;
 		len -= r;
@@ -459,7 +686,7 @@ pcm_read_u8_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_s16le(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_s16le(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -467,7 +694,7 @@ pcm_write_u8_as_s16le(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16LE(p, (*samples++ - 0x80) << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -476,7 +703,7 @@ pcm_write_u8_as_s16le(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_s16be(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_s16be(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -484,7 +711,7 @@ pcm_write_u8_as_s16be(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16BE(p, (*samples++ - 0x80) << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -493,14 +720,16 @@ pcm_write_u8_as_s16be(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u8_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_u8_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = buf[i] << 8;
 		len -= r;
@@ -510,7 +739,7 @@ pcm_read_u8_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_u16le(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_u16le(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -518,7 +747,7 @@ pcm_write_u8_as_u16le(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16LE(p, *samples++ << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -527,7 +756,7 @@ pcm_write_u8_as_u16le(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_u16be(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_u16be(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -535,7 +764,7 @@ pcm_write_u8_as_u16be(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16BE(p, *samples++ << 8);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -544,14 +773,16 @@ pcm_write_u8_as_u16be(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u8_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_u8_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = (buf[i] - 0x80) << 24;
 		len -= r;
@@ -561,7 +792,7 @@ pcm_read_u8_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_s32le(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_s32le(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -569,7 +800,7 @@ pcm_write_u8_as_s32le(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, (*samples++ - 0x80) << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -578,7 +809,7 @@ pcm_write_u8_as_s32le(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_s32be(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_s32be(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -586,7 +817,7 @@ pcm_write_u8_as_s32be(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, (*samples++ - 0x80) << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -595,14 +826,16 @@ pcm_write_u8_as_s32be(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u8_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_u8_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = buf[i] << 24;
 		len -= r;
@@ -612,7 +845,7 @@ pcm_read_u8_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_u32le(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_u32le(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -620,7 +853,7 @@ pcm_write_u8_as_u32le(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, *samples++ << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -629,7 +862,7 @@ pcm_write_u8_as_u32le(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_u32be(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_u32be(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -637,7 +870,7 @@ pcm_write_u8_as_u32be(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, *samples++ << 24);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -646,14 +879,16 @@ pcm_write_u8_as_u32be(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u8_as_f32(int fd, float *samples, size_t len)
+pcm_read_u8_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen)) == -1)
+		if ((r = au_io_read(file, buf, buflen)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0; i < r ; i++)
 			*samples++ = -1.0 + (2.0 * buf[i]) / UINT8_MAX;
 		len -= r;
@@ -663,7 +898,7 @@ pcm_read_u8_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_f32le(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_f32le(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -671,7 +906,7 @@ pcm_write_u8_as_f32le(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFLE(p, -1.0 + (*samples++ * 2.0) / UINT8_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -680,7 +915,7 @@ pcm_write_u8_as_f32le(int fd, const uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u8_as_f32be(int fd, const uint8_t *samples, size_t len)
+pcm_write_u8_as_f32be(AUFILE *file, const uint8_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -688,7 +923,7 @@ pcm_write_u8_as_f32be(int fd, const uint8_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFBE(p, -1.0 + (*samples++ * 2.0) / UINT8_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -699,16 +934,18 @@ pcm_write_u8_as_f32be(int fd, const uint8_t *samples, size_t len)
 /* int16_t */
 
 static ssize_t
-pcm_read_s16le_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_s16le_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((int16_t)R16LE(p)) >> 8;
+			*samples++ = NARROW(file, (int16_t)R16LE(p), 16, 8);
 		len -= r/2;
 		tot += r/2;
 	}
@@ -716,16 +953,18 @@ pcm_read_s16le_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16be_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_s16be_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((int16_t)R16BE(p)) >> 8;
+			*samples++ = NARROW(file, (int16_t)R16BE(p), 16, 8);
 		len -= r/2;
 		tot += r/2;
 	}
@@ -733,15 +972,15 @@ pcm_read_s16be_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_s8(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_s8(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = *samples++ >> 8;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++, 16, 8);
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -750,16 +989,19 @@ pcm_write_s16_as_s8(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16le_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_s16le_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (((int16_t)R16LE(p)) >> 8) + 0x80;
+			*samples++ = NARROW(file, (int16_t)R16LE(p),
+				16, 8) + 0x80;
 		len -= r/2;
 		tot += r/2;
 	}
@@ -767,16 +1009,19 @@ pcm_read_s16le_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16be_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_s16be_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (((int16_t)R16BE(p)) >> 8) + 0x80;
+			*samples++ = NARROW(file, (int16_t)R16BE(p),
+				16, 8) + 0x80;
 		len -= r/2;
 		tot += r/2;
 	}
@@ -784,15 +1029,15 @@ pcm_read_s16be_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_u8(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_u8(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = (*samples++ >> 8) + 0x80;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++, 16, 8) + 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -801,118 +1046,62 @@ pcm_write_s16_as_u8(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16le_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_s16le_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (int16_t)R16LE(p);
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_read_s16be_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_s16be_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (int16_t)R16BE(p);
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_write_s16_as_s16le(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_s16le(AUFILE *file, const int16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/2;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_write_s16_as_s16be(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_s16be(AUFILE *file, const int16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/2;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_read_s16le_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_s16le_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((int16_t)R16LE(p)) + 0x8000;
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 2)) == -1)
+		err(1, NULL);
+	r /= 2;
+	FLIP16LE((uint16_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_read_s16be_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_s16be_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((int16_t)R16BE(p)) + 0x8000;
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 2)) == -1)
+		err(1, NULL);
+	r /= 2;
+	FLIP16BE((uint16_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_write_s16_as_u16le(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_u16le(AUFILE *file, const int16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++ + 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		PUTFLIP16LE(buf, (const uint16_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/2;
 	}
@@ -920,16 +1109,16 @@ pcm_write_s16_as_u16le(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_u16be(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_u16be(AUFILE *file, const int16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++ + 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		PUTFLIP16BE(buf, (const uint16_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/2;
 	}
@@ -937,14 +1126,16 @@ pcm_write_s16_as_u16be(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16le_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_s16le_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = ((int16_t)R16LE(p)) << 16;
 		len -= r/2;
@@ -954,14 +1145,16 @@ pcm_read_s16le_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16be_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_s16be_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = ((int16_t)R16BE(p)) << 16;
 		len -= r/2;
@@ -971,7 +1164,7 @@ pcm_read_s16be_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_s32le(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_s32le(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -979,7 +1172,7 @@ pcm_write_s16_as_s32le(int fd, const int16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, *samples++ << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -988,7 +1181,7 @@ pcm_write_s16_as_s32le(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_s32be(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_s32be(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -996,7 +1189,7 @@ pcm_write_s16_as_s32be(int fd, const int16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, *samples++ << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1005,14 +1198,16 @@ pcm_write_s16_as_s32be(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16le_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_s16le_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = (((int16_t)R16LE(p)) << 16) + 0x80000000;
 		len -= r/2;
@@ -1022,14 +1217,16 @@ pcm_read_s16le_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16be_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_s16be_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = (((int16_t)R16BE(p)) << 16) + 0x80000000;
 		len -= r/2;
@@ -1039,7 +1236,7 @@ pcm_read_s16be_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_u32le(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_u32le(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1047,7 +1244,7 @@ pcm_write_s16_as_u32le(int fd, const int16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, (*samples++ << 16) + 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1056,7 +1253,7 @@ pcm_write_s16_as_u32le(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_u32be(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_u32be(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1064,7 +1261,7 @@ pcm_write_s16_as_u32be(int fd, const int16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, (*samples++ << 16) + 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1073,14 +1270,16 @@ pcm_write_s16_as_u32be(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16le_as_f32(int fd, float *samples, size_t len)
+pcm_read_s16le_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2, samples++) {
 			*samples = (int16_t)R16LE(p);
 			*samples /= *samples > 0 ? INT16_MAX : -INT16_MIN;
@@ -1092,14 +1291,16 @@ pcm_read_s16le_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s16be_as_f32(int fd, float *samples, size_t len)
+pcm_read_s16be_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2, samples++) {
 			*samples = (int16_t)R16BE(p);
 			*samples /= *samples > 0 ? INT16_MAX : -INT16_MIN;
@@ -1111,7 +1312,7 @@ pcm_read_s16be_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_f32le(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_f32le(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1121,7 +1322,7 @@ pcm_write_s16_as_f32le(int fd, const int16_t *samples, size_t len)
 			WFLE(p, *samples > 0
 				? (*samples *  1.0) / INT16_MAX
 				: (*samples * -1.0) / INT16_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -1130,7 +1331,7 @@ pcm_write_s16_as_f32le(int fd, const int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s16_as_f32be(int fd, const int16_t *samples, size_t len)
+pcm_write_s16_as_f32be(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1140,7 +1341,7 @@ pcm_write_s16_as_f32be(int fd, const int16_t *samples, size_t len)
 			WFBE(p, *samples > 0
 				? (*samples *  1.0) / INT16_MAX
 				: (*samples * -1.0) / INT16_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -1151,16 +1352,18 @@ pcm_write_s16_as_f32be(int fd, const int16_t *samples, size_t len)
 /* uint16_t */
 
 static ssize_t
-pcm_read_u16le_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_u16le_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (((uint16_t)R16LE(p)) - 0x8000) >> 8;
+			*samples++ = NARROW(file, R16LE(p) - 0x8000, 16, 8);
 		len -= r/2;
 		tot += r/2;
 	}
@@ -1168,16 +1371,18 @@ pcm_read_u16le_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16be_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_u16be_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (((uint16_t)R16BE(p)) - 0x8000) >> 8;
+			*samples++ = NARROW(file, R16BE(p) - 0x8000, 16, 8);
 		len -= r/2;
 		tot += r/2;
 	}
@@ -1185,15 +1390,15 @@ pcm_read_u16be_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_s8(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_s8(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = (*samples++ - 0x8000) >> 8;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++ - 0x8000, 16, 8);
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -1202,16 +1407,19 @@ pcm_write_u16_as_s8(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16le_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_u16le_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((uint16_t)R16LE(p)) >> 8;
+			*samples++ = NARROW(file, R16LE(p) - 0x8000,
+				16, 8) + 0x80;
 		len -= r/2;
 		tot += r/2;
 	}
@@ -1219,16 +1427,19 @@ pcm_read_u16le_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16be_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_u16be_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((uint16_t)R16BE(p)) >> 8;
+			*samples++ = NARROW(file, R16BE(p) - 0x8000,
+				16, 8) + 0x80;
 		len -= r/2;
 		tot += r/2;
 	}
@@ -1236,15 +1447,16 @@ pcm_read_u16be_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_u8(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_u8(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = *samples++ >> 8;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++ - 0x8000,
+				16, 8) + 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -1253,50 +1465,38 @@ pcm_write_u16_as_u8(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16le_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_u16le_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((uint16_t)R16LE(p)) - 0x8000;
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 2)) == -1)
+		err(1, NULL);
+	r /= 2;
+	FLIP16LE((uint16_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_read_u16be_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_u16be_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = ((uint16_t)R16BE(p)) - 0x8000;
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 2)) == -1)
+		err(1, NULL);
+	r /= 2;
+	FLIP16BE((uint16_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_write_u16_as_s16le(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_s16le(AUFILE *file, const uint16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++ - 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		PUTFLIP16LE(buf, (const uint16_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/2;
 	}
@@ -1304,16 +1504,16 @@ pcm_write_u16_as_s16le(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_s16be(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_s16be(AUFILE *file, const uint16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++ - 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		PUTFLIP16BE(buf, (const uint16_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/2;
 	}
@@ -1321,82 +1521,40 @@ pcm_write_u16_as_s16be(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16le_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_u16le_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (uint16_t)R16LE(p);
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_read_u16be_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_u16be_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 2, p += 2)
-			*samples++ = (uint16_t)R16BE(p);
-		len -= r/2;
-		tot += r/2;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_write_u16_as_u16le(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_u16le(AUFILE *file, const uint16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/2;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_write_u16_as_u16be(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_u16be(AUFILE *file, const uint16_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 2];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/2;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 2);
 }
 
 static ssize_t
-pcm_read_u16le_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_u16le_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = (((uint16_t)R16LE(p)) - 0x8000) << 16;
 		len -= r/2;
@@ -1406,14 +1564,16 @@ pcm_read_u16le_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16be_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_u16be_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = (((uint16_t)R16BE(p)) - 0x8000) << 16;
 		len -= r/2;
@@ -1423,7 +1583,7 @@ pcm_read_u16be_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_s32le(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_s32le(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1431,7 +1591,7 @@ pcm_write_u16_as_s32le(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, (*samples++ - 0x8000) << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1440,7 +1600,7 @@ pcm_write_u16_as_s32le(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_s32be(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_s32be(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1448,7 +1608,7 @@ pcm_write_u16_as_s32be(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, (*samples++ - 0x8000) << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1457,14 +1617,16 @@ pcm_write_u16_as_s32be(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16le_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_u16le_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = ((uint16_t)R16LE(p)) << 16;
 		len -= r/2;
@@ -1474,14 +1636,16 @@ pcm_read_u16le_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16be_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_u16be_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = ((uint16_t)R16BE(p)) << 16;
 		len -= r/2;
@@ -1491,7 +1655,7 @@ pcm_read_u16be_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_u32le(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_u32le(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1499,7 +1663,7 @@ pcm_write_u16_as_u32le(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, *samples++ << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1508,7 +1672,7 @@ pcm_write_u16_as_u32le(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_u32be(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_u32be(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1516,7 +1680,7 @@ pcm_write_u16_as_u32be(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, *samples++ << 16);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1525,14 +1689,16 @@ pcm_write_u16_as_u32be(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16le_as_f32(int fd, float *samples, size_t len)
+pcm_read_u16le_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = -1.0+(2.0*((uint16_t)R16LE(p)))/UINT16_MAX;
 		len -= r/2;
@@ -1542,14 +1708,16 @@ pcm_read_u16le_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u16be_as_f32(int fd, float *samples, size_t len)
+pcm_read_u16be_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 2)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 2, p += 2)
 			*samples++ = -1.0+(2.0*((uint16_t)R16BE(p)))/UINT16_MAX;
 		len -= r/2;
@@ -1559,7 +1727,7 @@ pcm_read_u16be_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_f32le(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_f32le(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1567,7 +1735,7 @@ pcm_write_u16_as_f32le(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFLE(p, -1.0 + (*samples++ * 2.0) / UINT16_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1576,7 +1744,7 @@ pcm_write_u16_as_f32le(int fd, const uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u16_as_f32be(int fd, const uint16_t *samples, size_t len)
+pcm_write_u16_as_f32be(AUFILE *file, const uint16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -1584,7 +1752,7 @@ pcm_write_u16_as_f32be(int fd, const uint16_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFBE(p, -1.0 + (*samples++ * 2.0) / UINT16_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -1595,16 +1763,18 @@ pcm_write_u16_as_f32be(int fd, const uint16_t *samples, size_t len)
 /* int32_t */
 
 static ssize_t
-pcm_read_s32le_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_s32le_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32LE(p)) >> 24;
+			*samples++ = NARROW(file, (int32_t)R32LE(p), 32, 8);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1612,16 +1782,18 @@ pcm_read_s32le_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32be_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_s32be_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32BE(p)) >> 24;
+			*samples++ = NARROW(file, (int32_t)R32BE(p), 32, 8);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1629,15 +1801,15 @@ pcm_read_s32be_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_s8(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_s8(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = *samples++ >> 24;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++, 32, 8);
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -1646,16 +1818,19 @@ pcm_write_s32_as_s8(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32le_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_s32le_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((int32_t)R32LE(p)) >> 24) + 0x80;
+			*samples++ = NARROW(file, (int32_t)R32LE(p),
+				32, 8) + 0x80;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1663,16 +1838,19 @@ pcm_read_s32le_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32be_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_s32be_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((int32_t)R32BE(p)) >> 24) + 0x80;
+			*samples++ = NARROW(file, (int32_t)R32BE(p),
+				32, 8) + 0x80;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1680,15 +1858,15 @@ pcm_read_s32be_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_u8(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_u8(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	uint8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = (*samples++ >> 24) + 0x80;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, *samples++, 32, 8) + 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -1697,16 +1875,18 @@ pcm_write_s32_as_u8(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32le_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_s32le_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32LE(p)) >> 16;
+			*samples++ = NARROW(file, (int32_t)R32LE(p), 32, 16);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1714,16 +1894,18 @@ pcm_read_s32le_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32be_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_s32be_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32BE(p)) >> 16;
+			*samples++ = NARROW(file, (int32_t)R32BE(p), 32, 16);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1731,15 +1913,15 @@ pcm_read_s32be_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_s16le(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_s16le(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++ >> 16);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16LE(p, NARROW(file, *samples++, 32, 16));
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -1748,15 +1930,15 @@ pcm_write_s32_as_s16le(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_s16be(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_s16be(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++ >> 16);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16BE(p, NARROW(file, *samples++, 32, 16));
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -1765,16 +1947,19 @@ pcm_write_s32_as_s16be(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32le_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_s32le_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((int32_t)R32LE(p)) >> 16) + 0x8000;
+			*samples++ = NARROW(file, (int32_t)R32LE(p),
+				32, 16) + 0x8000;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1782,16 +1967,19 @@ pcm_read_s32le_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32be_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_s32be_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((int32_t)R32BE(p)) >> 16) + 0x8000;
+			*samples++ = NARROW(file, (int32_t)R32BE(p),
+				32, 16) + 0x8000;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -1799,15 +1987,15 @@ pcm_read_s32be_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_u16le(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_u16le(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, (*samples++ >> 16) + 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16LE(p, NARROW(file, *samples++, 32, 16) + 0x8000);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -1816,15 +2004,15 @@ pcm_write_s32_as_u16le(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_u16be(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_u16be(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, (*samples++ >> 16) + 0x8000);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16BE(p, NARROW(file, *samples++, 32, 16) + 0x8000);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -1833,118 +2021,62 @@ pcm_write_s32_as_u16be(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32le_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_s32le_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (int32_t)R32LE(p);
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_read_s32be_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_s32be_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (int32_t)R32BE(p);
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_write_s32_as_s32le(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_s32le(AUFILE *file, const int32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32LE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/4;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_write_s32_as_s32be(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_s32be(AUFILE *file, const int32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32BE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/4;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_read_s32le_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_s32le_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32LE(p)) + 0x80000000;
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 4)) == -1)
+		err(1, NULL);
+	r /= 4;
+	FLIP32LE((uint32_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_read_s32be_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_s32be_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((int32_t)R32BE(p)) + 0x80000000;
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 4)) == -1)
+		err(1, NULL);
+	r /= 4;
+	FLIP32BE((uint32_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_write_s32_as_u32le(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_u32le(AUFILE *file, const int32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32LE(p, *samples++ + 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		PUTFLIP32LE(buf, (const uint32_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/4;
 	}
@@ -1952,16 +2084,16 @@ pcm_write_s32_as_u32le(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_u32be(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_u32be(AUFILE *file, const int32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32BE(p, *samples++ + 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		PUTFLIP32BE(buf, (const uint32_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/4;
 	}
@@ -1969,14 +2101,16 @@ pcm_write_s32_as_u32be(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32le_as_f32(int fd, float *samples, size_t len)
+pcm_read_s32le_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4, samples++) {
 			*samples = (int32_t)R32LE(p);
 			*samples /= *samples > 0 ? INT32_MAX : -1.0 * INT32_MIN;
@@ -1988,14 +2122,16 @@ pcm_read_s32le_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_s32be_as_f32(int fd, float *samples, size_t len)
+pcm_read_s32be_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4, samples++) {
 			*samples = (int32_t)R32BE(p);
 			*samples /= *samples>0 ? INT32_MAX : -1.0 * INT32_MIN;
@@ -2007,7 +2143,7 @@ pcm_read_s32be_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_f32le(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_f32le(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2017,7 +2153,7 @@ pcm_write_s32_as_f32le(int fd, const int32_t *samples, size_t len)
 			WFLE(p, *samples > 0
 				? (*samples *  1.0) / INT32_MAX
 				: (*samples * -1.0) / INT32_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -2026,7 +2162,7 @@ pcm_write_s32_as_f32le(int fd, const int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_s32_as_f32be(int fd, const int32_t *samples, size_t len)
+pcm_write_s32_as_f32be(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2036,7 +2172,7 @@ pcm_write_s32_as_f32be(int fd, const int32_t *samples, size_t len)
 			WFBE(p, *samples > 0
 				? (*samples *  1.0) / INT32_MAX
 				: (*samples * -1.0) / INT32_MIN);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w / 4;
@@ -2047,16 +2183,19 @@ pcm_write_s32_as_f32be(int fd, const int32_t *samples, size_t len)
 /* uint32_t */
 
 static ssize_t
-pcm_read_u32le_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_u32le_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((uint32_t)R32LE(p)) - 0x80000000 ) >> 24;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32LE(p) - 0x80000000),
+				32, 8);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2064,16 +2203,19 @@ pcm_read_u32le_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32be_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_u32be_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((uint32_t)R32BE(p)) - 0x80000000 ) >> 24;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32BE(p) - 0x80000000),
+				32, 8);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2081,15 +2223,16 @@ pcm_read_u32be_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_s8(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_s8(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = (*samples++ - 0x80000000) >> 24;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 8);
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -2098,16 +2241,19 @@ pcm_write_u32_as_s8(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32le_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_u32le_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32LE(p)) >> 24;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32LE(p) - 0x80000000),
+				32, 8) + 0x80;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2115,16 +2261,19 @@ pcm_read_u32le_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32be_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_u32be_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32BE(p)) >> 24;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32BE(p) - 0x80000000),
+				32, 8) + 0x80;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2132,15 +2281,16 @@ pcm_read_u32be_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_u8(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_u8(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
-			buf[i] = *samples++ >> 24;
-		if ((w = write(fd, buf, buflen)) == -1)
+			buf[i] = NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 8) + 0x80;
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -2149,16 +2299,19 @@ pcm_write_u32_as_u8(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32le_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_u32le_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((uint32_t)R32LE(p)) - 0x80000000) >> 16;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32LE(p) - 0x80000000),
+				32, 16);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2166,16 +2319,19 @@ pcm_read_u32le_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32be_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_u32be_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (((uint32_t)R32BE(p)) - 0x80000000) >> 16;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32BE(p) - 0x80000000),
+				32, 16);
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2183,15 +2339,16 @@ pcm_read_u32be_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_s16le(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_s16le(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, (*samples++ - 0x80000000) >> 16);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16LE(p, NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 16));
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2200,15 +2357,16 @@ pcm_write_u32_as_s16le(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_s16be(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_s16be(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, (*samples++ - 0x80000000) >> 16);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16BE(p, NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 16));
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2217,16 +2375,19 @@ pcm_write_u32_as_s16be(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32le_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_u32le_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32LE(p)) >> 16;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32LE(p) - 0x80000000),
+				32, 16) + 0x8000;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2234,16 +2395,19 @@ pcm_read_u32le_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32be_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_u32be_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32BE(p)) >> 16;
+			*samples++ = NARROW(file, (int32_t)((uint32_t)R32BE(p) - 0x80000000),
+				32, 16) + 0x8000;
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2251,15 +2415,16 @@ pcm_read_u32be_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_u16le(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_u16le(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16LE(p, *samples++ >> 16);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+			W16LE(p, NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 16) + 0x8000);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2268,16 +2433,17 @@ pcm_write_u32_as_u16le(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_u16be(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_u16be(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
-			W16BE(p, *samples++ >> 16);
+			W16BE(p, NARROW(file, (int32_t)(*samples++ - 0x80000000),
+				32, 16) + 0x8000);
 			/* FIXME: je vsude spravne [RW][16|32][BL]? */
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2286,50 +2452,38 @@ pcm_write_u32_as_u16be(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32le_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_u32le_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32LE(p)) - 0x80000000;
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 4)) == -1)
+		err(1, NULL);
+	r /= 4;
+	FLIP32LE((uint32_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_read_u32be_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_u32be_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = ((uint32_t)R32BE(p)) - 0x80000000;
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	ssize_t r;
+	if ((r = au_io_read(file, samples, len * 4)) == -1)
+		err(1, NULL);
+	r /= 4;
+	FLIP32BE((uint32_t*) samples, r);
+	return r;
 }
 
 static ssize_t
-pcm_write_u32_as_s32le(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_s32le(AUFILE *file, const uint32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32LE(p, *samples++ - 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		PUTFLIP32LE(buf, (const uint32_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/4;
 	}
@@ -2337,16 +2491,16 @@ pcm_write_u32_as_s32le(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_s32be(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_s32be(AUFILE *file, const uint32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
+	ssize_t w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32BE(p, *samples++ - 0x80000000);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		PUTFLIP32BE(buf, (const uint32_t*) samples, buflen);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		samples += buflen;
 		len -= buflen;
 		tot += w/4;
 	}
@@ -2354,82 +2508,40 @@ pcm_write_u32_as_s32be(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32le_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_u32le_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (uint32_t)R32LE(p);
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_read_u32be_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_u32be_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
-	ssize_t i, r, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = (uint32_t)R32BE(p);
-		len -= r/4;
-		tot += r/4;
-	}
-	return tot;
+	return pcm_read_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_write_u32_as_u32le(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_u32le(AUFILE *file, const uint32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32LE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/4;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_write_u32_as_u32be(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_u32be(AUFILE *file, const uint32_t *samples, size_t len)
 {
-	ssize_t i, w, buflen, tot = 0;
-	unsigned char *p, buf[BUFSIZE * 4];
-	while (len) {
-		buflen = MIN(len, BUFSIZE);
-		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			W32BE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
-			err(1, NULL);
-		len -= buflen;
-		tot += w/4;
-	}
-	return tot;
+	return pcm_write_same(file, samples, len, 4);
 }
 
 static ssize_t
-pcm_read_u32le_as_f32(int fd, float *samples, size_t len)
+pcm_read_u32le_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = -1.0+(2.0*((uint32_t)R32LE(p)))/UINT32_MAX;
 		len -= r/4;
@@ -2439,14 +2551,16 @@ pcm_read_u32le_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_u32be_as_f32(int fd, float *samples, size_t len)
+pcm_read_u32be_as_f32(AUFILE *file, float *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = -1.0+(2.0*((uint32_t)R32BE(p)))/UINT32_MAX;
 		len -= r/4;
@@ -2456,7 +2570,7 @@ pcm_read_u32be_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_f32le(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_f32le(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2464,7 +2578,7 @@ pcm_write_u32_as_f32le(int fd, const uint32_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFLE(p, -1.0 + (*samples++ * 2.0) / UINT32_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2473,7 +2587,7 @@ pcm_write_u32_as_f32le(int fd, const uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_u32_as_f32be(int fd, const uint32_t *samples, size_t len)
+pcm_write_u32_as_f32be(AUFILE *file, const uint32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2481,7 +2595,7 @@ pcm_write_u32_as_f32be(int fd, const uint32_t *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			WFBE(p, -1.0 + (*samples++ * 2.0) / UINT32_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2492,15 +2606,17 @@ pcm_write_u32_as_f32be(int fd, const uint32_t *samples, size_t len)
 /* float */
 
 static ssize_t
-pcm_read_f32le_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_f32le_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((f=RFLE(p))>0) ? f*INT8_MAX : -f*INT8_MIN;
 		len -= r/4;
@@ -2510,15 +2626,17 @@ pcm_read_f32le_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_s8(int fd, int8_t *samples, size_t len)
+pcm_read_f32be_as_s8(AUFILE *file, int8_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = (f=RFBE(p) > 0) ? f*INT8_MAX : -f*INT8_MIN;
 		len -= r/4;
@@ -2528,7 +2646,7 @@ pcm_read_f32be_as_s8(int fd, int8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_s8(int fd, const float *samples, size_t len)
+pcm_write_f32_as_s8(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
@@ -2538,7 +2656,7 @@ pcm_write_f32_as_s8(int fd, const float *samples, size_t len)
 			buf[i] = *samples > 0
 				? *samples * INT8_MAX
 				: *samples * INT8_MIN * -1.0;
-		if ((w = write(fd, buf, buflen)) == -1)
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -2547,14 +2665,16 @@ pcm_write_f32_as_s8(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_f32le_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFLE(p)) / 2.0) * UINT8_MAX;
 		len -= r/4;
@@ -2564,14 +2684,16 @@ pcm_read_f32le_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_u8(int fd, uint8_t *samples, size_t len)
+pcm_read_f32be_as_u8(AUFILE *file, uint8_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFBE(p)) / 2.0) * UINT8_MAX;
 		len -= r/4;
@@ -2581,7 +2703,7 @@ pcm_read_f32be_as_u8(int fd, uint8_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_u8(int fd, const float *samples, size_t len)
+pcm_write_f32_as_u8(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	int8_t buf[BUFSIZE];
@@ -2589,7 +2711,7 @@ pcm_write_f32_as_u8(int fd, const float *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0; i < buflen ; i++)
 			buf[i] = ((1.0 + *samples++) / 2.0) * UINT8_MAX;
-		if ((w = write(fd, buf, buflen)) == -1)
+		if ((w = au_io_write(file, buf, buflen)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w;
@@ -2598,15 +2720,17 @@ pcm_write_f32_as_u8(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_f32le_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ =((f=RFLE(p))>0) ? f*INT16_MAX: -f*INT16_MIN;
 		len -= r/4;
@@ -2616,15 +2740,17 @@ pcm_read_f32le_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_s16(int fd, int16_t *samples, size_t len)
+pcm_read_f32be_as_s16(AUFILE *file, int16_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ =((f=RFBE(p))>0) ? f*INT16_MAX: -f*INT16_MIN;
 		len -= r/4;
@@ -2634,7 +2760,7 @@ pcm_read_f32be_as_s16(int fd, int16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_s16le(int fd, const float *samples, size_t len)
+pcm_write_f32_as_s16le(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -2644,7 +2770,7 @@ pcm_write_f32_as_s16le(int fd, const float *samples, size_t len)
 			W16LE(p, *samples > 0
 				? *samples * INT16_MAX
 				: *samples * INT16_MIN * -1.0);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2653,7 +2779,7 @@ pcm_write_f32_as_s16le(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_s16be(int fd, const float *samples, size_t len)
+pcm_write_f32_as_s16be(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -2663,7 +2789,7 @@ pcm_write_f32_as_s16be(int fd, const float *samples, size_t len)
 			W16BE(p, *samples > 0
 				? *samples * INT16_MAX
 				: *samples * INT16_MIN * -1.0);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2672,14 +2798,16 @@ pcm_write_f32_as_s16be(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_f32le_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFLE(p)) / 2.0) * UINT16_MAX;
 		len -= r/4;
@@ -2689,14 +2817,16 @@ pcm_read_f32le_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_u16(int fd, uint16_t *samples, size_t len)
+pcm_read_f32be_as_u16(AUFILE *file, uint16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFBE(p)) / 2.0) * UINT16_MAX;
 		len -= r/4;
@@ -2706,7 +2836,7 @@ pcm_read_f32be_as_u16(int fd, uint16_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_u16le(int fd, const float *samples, size_t len)
+pcm_write_f32_as_u16le(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -2714,7 +2844,7 @@ pcm_write_f32_as_u16le(int fd, const float *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16LE(p, ((1.0 + *samples++) / 2.0) * UINT16_MAX);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2723,7 +2853,7 @@ pcm_write_f32_as_u16le(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_u16be(int fd, const float *samples, size_t len)
+pcm_write_f32_as_u16be(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 2];
@@ -2731,7 +2861,7 @@ pcm_write_f32_as_u16be(int fd, const float *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 2)
 			W16BE(p, ((1.0 + *samples++) / 2.0) * UINT16_MAX);
-		if ((w = write(fd, buf, buflen * 2)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/2;
@@ -2740,15 +2870,17 @@ pcm_write_f32_as_u16be(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_f32le_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ =((f=RFLE(p))>0) ? f*INT32_MAX: -f*INT32_MIN;
 		len -= r/4;
@@ -2758,15 +2890,17 @@ pcm_read_f32le_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_s32(int fd, int32_t *samples, size_t len)
+pcm_read_f32be_as_s32(AUFILE *file, int32_t *samples, size_t len)
 {
 	float f = 0;
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ =((f=RFBE(p))>0) ? f*INT32_MAX: -f*INT32_MIN;
 		len -= r/4;
@@ -2776,7 +2910,7 @@ pcm_read_f32be_as_s32(int fd, int32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_s32le(int fd, const float *samples, size_t len)
+pcm_write_f32_as_s32le(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2786,7 +2920,7 @@ pcm_write_f32_as_s32le(int fd, const float *samples, size_t len)
 			W32LE(p, *samples > 0
 				? *samples * INT32_MAX
 				: *samples * INT32_MIN * -1.0);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2795,7 +2929,7 @@ pcm_write_f32_as_s32le(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_s32be(int fd, const float *samples, size_t len)
+pcm_write_f32_as_s32be(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2805,7 +2939,7 @@ pcm_write_f32_as_s32be(int fd, const float *samples, size_t len)
 			W32BE(p, *samples > 0
 				? *samples * INT32_MAX
 				: *samples * INT32_MIN * -1.0);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2814,14 +2948,16 @@ pcm_write_f32_as_s32be(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_f32le_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFLE(p)) / 2.0) * UINT32_MAX;
 		len -= r/4;
@@ -2831,14 +2967,16 @@ pcm_read_f32le_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_u32(int fd, uint32_t *samples, size_t len)
+pcm_read_f32be_as_u32(AUFILE *file, uint32_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
 			*samples++ = ((1.0 + RFBE(p)) / 2.0) * UINT32_MAX;
 		len -= r/4;
@@ -2848,7 +2986,7 @@ pcm_read_f32be_as_u32(int fd, uint32_t *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_u32le(int fd, const float *samples, size_t len)
+pcm_write_f32_as_u32le(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2856,7 +2994,7 @@ pcm_write_f32_as_u32le(int fd, const float *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32LE(p, ((1.0 + *samples++) / 2.0) * UINT32_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2865,7 +3003,7 @@ pcm_write_f32_as_u32le(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_u32be(int fd, const float *samples, size_t len)
+pcm_write_f32_as_u32be(AUFILE *file, const float *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
@@ -2873,7 +3011,7 @@ pcm_write_f32_as_u32be(int fd, const float *samples, size_t len)
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
 			W32BE(p, ((1.0 + *samples++) / 2.0) * UINT32_MAX);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
 		tot += w/4;
@@ -2882,16 +3020,43 @@ pcm_write_f32_as_u32be(int fd, const float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32le_as_f32(int fd, float *samples, size_t len)
+pcm_read_f32le_as_f32(AUFILE *file, float *samples, size_t len)
+{
+	return pcm_read_same(file, samples, len, 4);
+}
+
+static ssize_t
+pcm_read_f32be_as_f32(AUFILE *file, float *samples, size_t len)
+{
+	return pcm_read_same(file, samples, len, 4);
+}
+
+static ssize_t
+pcm_write_f32_as_f32le(AUFILE *file, const float *samples, size_t len)
+{
+	return pcm_write_same(file, samples, len, 4);
+}
+
+static ssize_t
+pcm_write_f32_as_f32be(AUFILE *file, const float *samples, size_t len)
+{
+	return pcm_write_same(file, samples, len, 4);
+}
+
+
+static ssize_t
+pcm_read_f32le_as_q15(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = RFLE(p);
+			*samples++ = Q15(RFLE(p));
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2899,16 +3064,35 @@ pcm_read_f32le_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_read_f32be_as_f32(int fd, float *samples, size_t len)
+pcm_write_q15_as_f32le(AUFILE *file, const int16_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
+			WFLE(p, *samples++ / 32768.0f);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_f32be_as_q15(AUFILE *file, int16_t *samples, size_t len)
 {
 	ssize_t i, r, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
-		if ((r = read(fd, buf, buflen * 4)) == -1)
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
+		if (r == 0)
+			break;
 		for (i = 0, p = buf; i < r ; i += 4, p += 4)
-			*samples++ = RFBE(p);
+			*samples++ = Q15(RFBE(p));
 		len -= r/4;
 		tot += r/4;
 	}
@@ -2916,288 +3100,1242 @@ pcm_read_f32be_as_f32(int fd, float *samples, size_t len)
 }
 
 static ssize_t
-pcm_write_f32_as_f32le(int fd, const float *samples, size_t len)
+pcm_write_q15_as_f32be(AUFILE *file, const int16_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			WFLE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+			WFBE(p, *samples++ / 32768.0f);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
-		tot += w/4;
+		tot += w / 4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_f32le_as_q31(AUFILE *file, int32_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4)
+			*samples++ = Q31(RFLE(p));
+		len -= r/4;
+		tot += r/4;
 	}
 	return tot;
 }
 
 static ssize_t
-pcm_write_f32_as_f32be(int fd, const float *samples, size_t len)
+pcm_write_q31_as_f32le(AUFILE *file, const int32_t *samples, size_t len)
 {
 	ssize_t i, w, buflen, tot = 0;
 	unsigned char *p, buf[BUFSIZE * 4];
 	while (len) {
 		buflen = MIN(len, BUFSIZE);
 		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
-			WFBE(p, *samples++);
-		if ((w = write(fd, buf, buflen * 4)) == -1)
+			WFLE(p, *samples++ / 2147483648.0f);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
 			err(1, NULL);
 		len -= buflen;
-		tot += w/4;
+		tot += w / 4;
 	}
 	return tot;
 }
 
+static ssize_t
+pcm_read_f32be_as_q31(AUFILE *file, int32_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4)
+			*samples++ = Q31(RFBE(p));
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
 
-int
-pcm_init(AUFILE *file)
+static ssize_t
+pcm_write_q31_as_f32be(AUFILE *file, const int32_t *samples, size_t len)
 {
-	if (file == NULL || file->info == NULL)
-		return -1;
-	if ((file->info->encoding & AU_ENCTYPE_MASK) != AU_ENCTYPE_PCM) {
-		warnx("Will not intitialize non PCM file as PCM");
-		return -1;
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0, p = buf; i < buflen; i += 1, p += 4)
+			WFBE(p, *samples++ / 2147483648.0f);
+		if ((w = au_io_write(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 4;
 	}
+	return tot;
+}
 
-	if (file->mode == AU_READ) {
-		switch (file->info->encoding
-		& (AU_ENCODING_MASK | AU_ORDER_MASK | AU_BITSIZE_MASK)) {
-		case AU_ENCODING_SIGNED | AU_ORDER_NONE | 8:
-			file->au_read_s8  = pcm_read_s8_as_s8;
-			file->au_read_u8  = pcm_read_s8_as_u8;
-			file->au_read_s16 = pcm_read_s8_as_s16;
-			file->au_read_u16 = pcm_read_s8_as_u16;
-			file->au_read_s32 = pcm_read_s8_as_s32;
-			file->au_read_u32 = pcm_read_s8_as_u32;
-			file->au_read_f32 = pcm_read_s8_as_f32;
-			break;
-		case AU_ENCODING_UNSIGNED | AU_ORDER_NONE | 8:
-			file->au_read_s8  = pcm_read_u8_as_s8;
-			file->au_read_u8  = pcm_read_u8_as_u8;
-			file->au_read_s16 = pcm_read_u8_as_s16;
-			file->au_read_u16 = pcm_read_u8_as_u16;
-			file->au_read_s32 = pcm_read_u8_as_s32;
-			file->au_read_u32 = pcm_read_u8_as_u32;
-			file->au_read_f32 = pcm_read_u8_as_f32;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_LE | 16:
-			file->au_read_s8  = pcm_read_s16le_as_s8;
-			file->au_read_u8  = pcm_read_s16le_as_u8;
-			file->au_read_s16 = pcm_read_s16le_as_s16;
-			file->au_read_u16 = pcm_read_s16le_as_u16;
-			file->au_read_s32 = pcm_read_s16le_as_s32;
-			file->au_read_u32 = pcm_read_s16le_as_u32;
-			file->au_read_f32 = pcm_read_s16le_as_f32;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_BE | 16:
-			file->au_read_s8  = pcm_read_s16be_as_s8;
-			file->au_read_u8  = pcm_read_s16be_as_u8;
-			file->au_read_s16 = pcm_read_s16be_as_s16;
-			file->au_read_u16 = pcm_read_s16be_as_u16;
-			file->au_read_s32 = pcm_read_s16be_as_s32;
-			file->au_read_u32 = pcm_read_s16be_as_u32;
-			file->au_read_f32 = pcm_read_s16be_as_f32;
-			break;
-		case AU_ENCODING_UNSIGNED | AU_ORDER_LE | 16:
-			file->au_read_s8  = pcm_read_u16le_as_s8;
-			file->au_read_u8  = pcm_read_u16le_as_u8;
-			file->au_read_s16 = pcm_read_u16le_as_s16;
-			file->au_read_u16 = pcm_read_u16le_as_u16;
-			file->au_read_s32 = pcm_read_u16le_as_s32;
-			file->au_read_u32 = pcm_read_u16le_as_u32;
-			file->au_read_f32 = pcm_read_u16le_as_f32;
-			break;
-		case AU_ENCODING_UNSIGNED | AU_ORDER_BE | 16:
-			file->au_read_s8  = pcm_read_u16be_as_s8;
-			file->au_read_u8  = pcm_read_u16be_as_u8;
-			file->au_read_s16 = pcm_read_u16be_as_s16;
-			file->au_read_u16 = pcm_read_u16be_as_u16;
-			file->au_read_s32 = pcm_read_u16be_as_s32;
-			file->au_read_u32 = pcm_read_u16be_as_u32;
-			file->au_read_f32 = pcm_read_u16be_as_f32;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_LE | 32:
-			file->au_read_s8  = pcm_read_s32le_as_s8;
-			file->au_read_u8  = pcm_read_s32le_as_u8;
-			file->au_read_s16 = pcm_read_s32le_as_s16;
-			file->au_read_u16 = pcm_read_s32le_as_u16;
-			file->au_read_s32 = pcm_read_s32le_as_s32;
-			file->au_read_u32 = pcm_read_s32le_as_u32;
-			file->au_read_f32 = pcm_read_s32le_as_f32;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_BE | 32:
-			file->au_read_s8  = pcm_read_s32be_as_s8;
-			file->au_read_u8  = pcm_read_s32be_as_u8;
-			file->au_read_s16 = pcm_read_s32be_as_s16;
-			file->au_read_u16 = pcm_read_s32be_as_u16;
-			file->au_read_s32 = pcm_read_s32be_as_s32;
-			file->au_read_u32 = pcm_read_s32be_as_u32;
-			file->au_read_f32 = pcm_read_s32be_as_f32;
-			break;
-		case AU_ENCODING_UNSIGNED | AU_ORDER_LE | 32:
-			file->au_read_s8  = pcm_read_u32le_as_s8;
-			file->au_read_u8  = pcm_read_u32le_as_u8;
-			file->au_read_s16 = pcm_read_u32le_as_s16;
-			file->au_read_u16 = pcm_read_u32le_as_u16;
-			file->au_read_s32 = pcm_read_u32le_as_s32;
-			file->au_read_u32 = pcm_read_u32le_as_u32;
-			file->au_read_f32 = pcm_read_u32le_as_f32;
-			break;
-		case AU_ENCODING_UNSIGNED | AU_ORDER_BE | 32:
-			file->au_read_s8  = pcm_read_u32be_as_s8;
-			file->au_read_u8  = pcm_read_u32be_as_u8;
-			file->au_read_s16 = pcm_read_u32be_as_s16;
-			file->au_read_u16 = pcm_read_u32be_as_u16;
-			file->au_read_s32 = pcm_read_u32be_as_s32;
-			file->au_read_u32 = pcm_read_u32be_as_u32;
-			file->au_read_f32 = pcm_read_u32be_as_f32;
-			break;
-		case AU_ENCODING_FLOAT | AU_ORDER_LE | 32:
-			file->au_read_s8  = pcm_read_f32le_as_s8;
-			file->au_read_u8  = pcm_read_f32le_as_u8;
-			file->au_read_s16 = pcm_read_f32le_as_s16;
-			file->au_read_u16 = pcm_read_f32le_as_u16;
-			file->au_read_s32 = pcm_read_f32le_as_s32;
-			file->au_read_u32 = pcm_read_f32le_as_u32;
-			file->au_read_f32 = pcm_read_f32le_as_f32;
-			break;
-		case AU_ENCODING_FLOAT | AU_ORDER_BE | 32:
-			file->au_read_s8  = pcm_read_f32be_as_s8;
-			file->au_read_u8  = pcm_read_f32be_as_u8;
-			file->au_read_s16 = pcm_read_f32be_as_s16;
-			file->au_read_u16 = pcm_read_f32be_as_u16;
-			file->au_read_s32 = pcm_read_f32be_as_s32;
-			file->au_read_u32 = pcm_read_f32be_as_u32;
-			file->au_read_f32 = pcm_read_f32be_as_f32;
-			break;
-		default:
-			warnx("Don't know how to read this PCM:");
-			print_encoding(file->info->encoding);
-			return -1;
-			break;
-		}
+
+/* half float: IEEE 754 binary16, and bfloat16,
+ * which is just the top half of a 32 bit float.
+ * The same routines serve both, in both byte orders:
+ * a block of samples is converted from or into floats,
+ * and the floats are converted as with 32 bit floats. */
+
+static float
+F16(uint16_t h)
+{
+	ufloat uf;
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f, man = h & 0x3ff;
+	if (exp == 0x1f) {
+		/* infinity or NaN */
+		uf.u = sign | 0x7f800000 | man << 13;
+	} else if (exp) {
+		uf.u = sign | (exp + 112) << 23 | man << 13;
+	} else if (man) {
+		/* subnormal, becomes a normal float */
+		for (exp = 113; (man & 0x400) == 0; exp--)
+			man <<= 1;
+		uf.u = sign | exp << 23 | (man & 0x3ff) << 13;
+	} else {
+		uf.u = sign;
 	}
+	return uf.f;
+}
 
-	if (file->mode == AU_WRITE) {
-		switch (file->info->encoding
-		& (AU_ENCODING_MASK | AU_ORDER_MASK | AU_BITSIZE_MASK)) {
-		case AU_ENCODING_SIGNED | AU_ORDER_NONE | 8:
-			file->au_write_s8  = pcm_write_s8_as_s8;
-			file->au_write_u8  = pcm_write_u8_as_s8;
-			file->au_write_s16 = pcm_write_s16_as_s8;
-			file->au_write_u16 = pcm_write_u16_as_s8;
-			file->au_write_s32 = pcm_write_s32_as_s8;
-			file->au_write_u32 = pcm_write_u32_as_s8;
-			file->au_write_f32 = pcm_write_f32_as_s8;
+/* Round to the nearest half, ties to even. */
+static uint16_t
+TOF16(float f)
+{
+	ufloat uf;
+	uint32_t sign, man, rem, half, h;
+	int32_t exp;
+	uf.f = f;
+	sign = (uf.u >> 16) & 0x8000;
+	man = uf.u & 0x7fffff;
+	if (((uf.u >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (man ? 0x200 : 0);
+	exp = (int32_t)((uf.u >> 23) & 0xff) - 112;
+	if (exp >= 0x1f)
+		return sign | 0x7c00;
+	if (exp <= 0) {
+		/* subnormal, or too small for anything but zero */
+		if (exp < -10)
+			return sign;
+		man |= 0x800000;
+		h = man >> (14 - exp);
+		rem = man & ((1u << (14 - exp)) - 1);
+		half = 1u << (13 - exp);
+	} else {
+		h = exp << 10 | man >> 13;
+		rem = man & 0x1fff;
+		half = 0x1000;
+	}
+	if (rem > half || (rem == half && (h & 1)))
+		h++;
+	return sign | h;
+}
+
+static float
+BF16(uint16_t h)
+{
+	ufloat uf;
+	uf.u = (uint32_t)h << 16;
+	return uf.f;
+}
+
+static uint16_t
+TOBF16(float f)
+{
+	ufloat uf;
+	uf.f = f;
+	if ((uf.u & 0x7fffffff) > 0x7f800000)
+		return (uf.u >> 16) | 0x40;
+	uf.u += 0x7fff + ((uf.u >> 16) & 1);
+	return uf.u >> 16;
+}
+
+static void
+pcm_half_get(AUFILE *file, const unsigned char *p, float *f, size_t n)
+{
+	size_t i;
+	switch (file->info->encoding & (AU_ENCODING_MASK | AU_ORDER_MASK)) {
+	case AU_ENCODING_FLOAT | AU_ORDER_LE:
+		for (i = 0; i < n; i++, p += 2)
+			f[i] = F16(R16LE(p));
+		break;
+	case AU_ENCODING_FLOAT | AU_ORDER_BE:
+		for (i = 0; i < n; i++, p += 2)
+			f[i] = F16(R16BE(p));
+		break;
+	case AU_ENCODING_BFLOAT | AU_ORDER_LE:
+		for (i = 0; i < n; i++, p += 2)
+			f[i] = BF16(R16LE(p));
+		break;
+	case AU_ENCODING_BFLOAT | AU_ORDER_BE:
+		for (i = 0; i < n; i++, p += 2)
+			f[i] = BF16(R16BE(p));
+		break;
+	}
+}
+
+static void
+pcm_half_put(AUFILE *file, unsigned char *p, const float *f, size_t n)
+{
+	size_t i;
+	switch (file->info->encoding & (AU_ENCODING_MASK | AU_ORDER_MASK)) {
+	case AU_ENCODING_FLOAT | AU_ORDER_LE:
+		for (i = 0; i < n; i++, p += 2)
+			W16LE(p, TOF16(f[i]));
+		break;
+	case AU_ENCODING_FLOAT | AU_ORDER_BE:
+		for (i = 0; i < n; i++, p += 2)
+			W16BE(p, TOF16(f[i]));
+		break;
+	case AU_ENCODING_BFLOAT | AU_ORDER_LE:
+		for (i = 0; i < n; i++, p += 2)
+			W16LE(p, TOBF16(f[i]));
+		break;
+	case AU_ENCODING_BFLOAT | AU_ORDER_BE:
+		for (i = 0; i < n; i++, p += 2)
+			W16BE(p, TOBF16(f[i]));
+		break;
+	}
+}
+
+static ssize_t
+pcm_read_half_as_s8(AUFILE *file, int8_t *samples, size_t len)
+{
+	float f;
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((f = fbuf[i]) > 0) ? f*INT8_MAX : -f*INT8_MIN;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_s8_as_half(AUFILE *file, const int8_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples > 0
+				? (*samples *  1.0) / INT8_MAX
+				: (*samples * -1.0) / INT8_MIN;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_u8(AUFILE *file, uint8_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((1.0 + fbuf[i]) / 2.0) * UINT8_MAX;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_u8_as_half(AUFILE *file, const uint8_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = -1.0 + (*samples * 2.0) / UINT8_MAX;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_s16(AUFILE *file, int16_t *samples, size_t len)
+{
+	float f;
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((f = fbuf[i]) > 0) ? f*INT16_MAX : -f*INT16_MIN;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_s16_as_half(AUFILE *file, const int16_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples > 0
+				? (*samples *  1.0) / INT16_MAX
+				: (*samples * -1.0) / INT16_MIN;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_u16(AUFILE *file, uint16_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((1.0 + fbuf[i]) / 2.0) * UINT16_MAX;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_u16_as_half(AUFILE *file, const uint16_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = -1.0 + (*samples * 2.0) / UINT16_MAX;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_s32(AUFILE *file, int32_t *samples, size_t len)
+{
+	float f;
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((f = fbuf[i]) > 0) ? f*INT32_MAX : -f*INT32_MIN;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_s32_as_half(AUFILE *file, const int32_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples > 0
+				? (*samples *  1.0) / INT32_MAX
+				: (*samples * -1.0) / INT32_MIN;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_u32(AUFILE *file, uint32_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = ((1.0 + fbuf[i]) / 2.0) * UINT32_MAX;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_u32_as_half(AUFILE *file, const uint32_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = -1.0 + (*samples * 2.0) / UINT32_MAX;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_f32(AUFILE *file, float *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = fbuf[i];
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_f32_as_half(AUFILE *file, const float *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_q15(AUFILE *file, int16_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = Q15(fbuf[i]);
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_q15_as_half(AUFILE *file, const int16_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples / 32768.0f;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_read_half_as_q31(AUFILE *file, int32_t *samples, size_t len)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*samples++ = Q31(fbuf[i]);
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_write_q31_as_half(AUFILE *file, const int32_t *samples, size_t len)
+{
+	ssize_t i, w, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		for (i = 0; i < buflen; i++, samples++)
+			fbuf[i] = *samples / 2147483648.0f;
+		pcm_half_put(file, buf, fbuf, buflen);
+		if ((w = au_io_write(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		len -= buflen;
+		tot += w / 2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_half_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char buf[BUFSIZE * 2];
+	float fbuf[BUFSIZE];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		r /= 2;
+		pcm_half_get(file, buf, fbuf, r);
+		for (i = 0; i < r ; i++)
+			*acc++ += gain * fbuf[i];
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+
+/* Accumulating routines: these read samples as floats, like the
+ * pcm_read_*_as_f32() routines, but add them multiplied by gain
+ * into the samples already in acc, decoding and adding in one pass. */
+
+static ssize_t
+pcm_acc_s8_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	int8_t buf[BUFSIZE];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0; i < r ; i++) {
+			f = buf[i] > 0
+				? ( 1.0 * buf[i]) / INT8_MAX
+				: (-1.0 * buf[i]) / INT8_MIN;
+			*acc++ += gain * f;
+		}
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_u8_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	uint8_t buf[BUFSIZE];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0; i < r ; i++) {
+			f = -1.0 + (2.0 * buf[i]) / UINT8_MAX;
+			*acc++ += gain * f;
+		}
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_s16le_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 2];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 2, p += 2) {
+			f = (int16_t)R16LE(p);
+			f /= f > 0 ? INT16_MAX : -INT16_MIN;
+			*acc++ += gain * f;
+		}
+		len -= r/2;
+		tot += r/2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_s16be_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 2];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 2, p += 2) {
+			f = (int16_t)R16BE(p);
+			f /= f > 0 ? INT16_MAX : -INT16_MIN;
+			*acc++ += gain * f;
+		}
+		len -= r/2;
+		tot += r/2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_u16le_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 2];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 2, p += 2) {
+			f = -1.0+(2.0*((uint16_t)R16LE(p)))/UINT16_MAX;
+			*acc++ += gain * f;
+		}
+		len -= r/2;
+		tot += r/2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_u16be_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 2];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 2)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 2, p += 2) {
+			f = -1.0+(2.0*((uint16_t)R16BE(p)))/UINT16_MAX;
+			*acc++ += gain * f;
+		}
+		len -= r/2;
+		tot += r/2;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_s32le_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4) {
+			f = (int32_t)R32LE(p);
+			f /= f > 0 ? INT32_MAX : -1.0 * INT32_MIN;
+			*acc++ += gain * f;
+		}
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_s32be_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4) {
+			f = (int32_t)R32BE(p);
+			f /= f > 0 ? INT32_MAX : -1.0 * INT32_MIN;
+			*acc++ += gain * f;
+		}
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_u32le_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4) {
+			f = -1.0+(2.0*((uint32_t)R32LE(p)))/UINT32_MAX;
+			*acc++ += gain * f;
+		}
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_u32be_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	float f;
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4) {
+			f = -1.0+(2.0*((uint32_t)R32BE(p)))/UINT32_MAX;
+			*acc++ += gain * f;
+		}
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_f32le_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4)
+			*acc++ += gain * RFLE(p);
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+static ssize_t
+pcm_acc_f32be_as_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	ssize_t i, r, buflen, tot = 0;
+	unsigned char *p, buf[BUFSIZE * 4];
+	while (len) {
+		buflen = MIN(len, BUFSIZE);
+		if ((r = au_io_read(file, buf, buflen * 4)) == -1)
+			err(1, NULL);
+		if (r == 0)
+			break;
+		for (i = 0, p = buf; i < r ; i += 4, p += 4)
+			*acc++ += gain * RFBE(p);
+		len -= r/4;
+		tot += r/4;
+	}
+	return tot;
+}
+
+
+/* The routines of each encoding, shared by all the files in it.
+ * The Q15 and Q31 samples of the integer encodings are just
+ * their s16 and s32 samples. */
+
+static const AUOPS pcm_s8 = {
+	.read_s8 	= pcm_read_s8_as_s8,
+	.read_u8 	= pcm_read_s8_as_u8,
+	.read_s16	= pcm_read_s8_as_s16,
+	.read_u16	= pcm_read_s8_as_u16,
+	.read_s32	= pcm_read_s8_as_s32,
+	.read_u32	= pcm_read_s8_as_u32,
+	.read_f32	= pcm_read_s8_as_f32,
+	.acc_f32	= pcm_acc_s8_as_f32,
+	.read_q15	= pcm_read_s8_as_s16,
+	.read_q31	= pcm_read_s8_as_s32,
+	.write_s8 	= pcm_write_s8_as_s8,
+	.write_u8 	= pcm_write_u8_as_s8,
+	.write_s16	= pcm_write_s16_as_s8,
+	.write_u16	= pcm_write_u16_as_s8,
+	.write_s32	= pcm_write_s32_as_s8,
+	.write_u32	= pcm_write_u32_as_s8,
+	.write_f32	= pcm_write_f32_as_s8,
+	.write_q15	= pcm_write_s16_as_s8,
+	.write_q31	= pcm_write_s32_as_s8,
+};
+
+static const AUOPS pcm_u8 = {
+	.read_s8 	= pcm_read_u8_as_s8,
+	.read_u8 	= pcm_read_u8_as_u8,
+	.read_s16	= pcm_read_u8_as_s16,
+	.read_u16	= pcm_read_u8_as_u16,
+	.read_s32	= pcm_read_u8_as_s32,
+	.read_u32	= pcm_read_u8_as_u32,
+	.read_f32	= pcm_read_u8_as_f32,
+	.acc_f32	= pcm_acc_u8_as_f32,
+	.read_q15	= pcm_read_u8_as_s16,
+	.read_q31	= pcm_read_u8_as_s32,
+	.write_s8 	= pcm_write_s8_as_u8,
+	.write_u8 	= pcm_write_u8_as_u8,
+	.write_s16	= pcm_write_s16_as_u8,
+	.write_u16	= pcm_write_u16_as_u8,
+	.write_s32	= pcm_write_s32_as_u8,
+	.write_u32	= pcm_write_u32_as_u8,
+	.write_f32	= pcm_write_f32_as_u8,
+	.write_q15	= pcm_write_s16_as_u8,
+	.write_q31	= pcm_write_s32_as_u8,
+};
+
+static const AUOPS pcm_s16le = {
+	.read_s8 	= pcm_read_s16le_as_s8,
+	.read_u8 	= pcm_read_s16le_as_u8,
+	.read_s16	= pcm_read_s16le_as_s16,
+	.read_u16	= pcm_read_s16le_as_u16,
+	.read_s32	= pcm_read_s16le_as_s32,
+	.read_u32	= pcm_read_s16le_as_u32,
+	.read_f32	= pcm_read_s16le_as_f32,
+	.acc_f32	= pcm_acc_s16le_as_f32,
+	.read_q15	= pcm_read_s16le_as_s16,
+	.read_q31	= pcm_read_s16le_as_s32,
+	.write_s8 	= pcm_write_s8_as_s16le,
+	.write_u8 	= pcm_write_u8_as_s16le,
+	.write_s16	= pcm_write_s16_as_s16le,
+	.write_u16	= pcm_write_u16_as_s16le,
+	.write_s32	= pcm_write_s32_as_s16le,
+	.write_u32	= pcm_write_u32_as_s16le,
+	.write_f32	= pcm_write_f32_as_s16le,
+	.write_q15	= pcm_write_s16_as_s16le,
+	.write_q31	= pcm_write_s32_as_s16le,
+};
+
+static const AUOPS pcm_s16be = {
+	.read_s8 	= pcm_read_s16be_as_s8,
+	.read_u8 	= pcm_read_s16be_as_u8,
+	.read_s16	= pcm_read_s16be_as_s16,
+	.read_u16	= pcm_read_s16be_as_u16,
+	.read_s32	= pcm_read_s16be_as_s32,
+	.read_u32	= pcm_read_s16be_as_u32,
+	.read_f32	= pcm_read_s16be_as_f32,
+	.acc_f32	= pcm_acc_s16be_as_f32,
+	.read_q15	= pcm_read_s16be_as_s16,
+	.read_q31	= pcm_read_s16be_as_s32,
+	.write_s8 	= pcm_write_s8_as_s16be,
+	.write_u8 	= pcm_write_u8_as_s16be,
+	.write_s16	= pcm_write_s16_as_s16be,
+	.write_u16	= pcm_write_u16_as_s16be,
+	.write_s32	= pcm_write_s32_as_s16be,
+	.write_u32	= pcm_write_u32_as_s16be,
+	.write_f32	= pcm_write_f32_as_s16be,
+	.write_q15	= pcm_write_s16_as_s16be,
+	.write_q31	= pcm_write_s32_as_s16be,
+};
+
+static const AUOPS pcm_u16le = {
+	.read_s8 	= pcm_read_u16le_as_s8,
+	.read_u8 	= pcm_read_u16le_as_u8,
+	.read_s16	= pcm_read_u16le_as_s16,
+	.read_u16	= pcm_read_u16le_as_u16,
+	.read_s32	= pcm_read_u16le_as_s32,
+	.read_u32	= pcm_read_u16le_as_u32,
+	.read_f32	= pcm_read_u16le_as_f32,
+	.acc_f32	= pcm_acc_u16le_as_f32,
+	.read_q15	= pcm_read_u16le_as_s16,
+	.read_q31	= pcm_read_u16le_as_s32,
+	.write_s8 	= pcm_write_s8_as_u16le,
+	.write_u8 	= pcm_write_u8_as_u16le,
+	.write_s16	= pcm_write_s16_as_u16le,
+	.write_u16	= pcm_write_u16_as_u16le,
+	.write_s32	= pcm_write_s32_as_u16le,
+	.write_u32	= pcm_write_u32_as_u16le,
+	.write_f32	= pcm_write_f32_as_u16le,
+	.write_q15	= pcm_write_s16_as_u16le,
+	.write_q31	= pcm_write_s32_as_u16le,
+};
+
+static const AUOPS pcm_u16be = {
+	.read_s8 	= pcm_read_u16be_as_s8,
+	.read_u8 	= pcm_read_u16be_as_u8,
+	.read_s16	= pcm_read_u16be_as_s16,
+	.read_u16	= pcm_read_u16be_as_u16,
+	.read_s32	= pcm_read_u16be_as_s32,
+	.read_u32	= pcm_read_u16be_as_u32,
+	.read_f32	= pcm_read_u16be_as_f32,
+	.acc_f32	= pcm_acc_u16be_as_f32,
+	.read_q15	= pcm_read_u16be_as_s16,
+	.read_q31	= pcm_read_u16be_as_s32,
+	.write_s8 	= pcm_write_s8_as_u16be,
+	.write_u8 	= pcm_write_u8_as_u16be,
+	.write_s16	= pcm_write_s16_as_u16be,
+	.write_u16	= pcm_write_u16_as_u16be,
+	.write_s32	= pcm_write_s32_as_u16be,
+	.write_u32	= pcm_write_u32_as_u16be,
+	.write_f32	= pcm_write_f32_as_u16be,
+	.write_q15	= pcm_write_s16_as_u16be,
+	.write_q31	= pcm_write_s32_as_u16be,
+};
+
+static const AUOPS pcm_s32le = {
+	.read_s8 	= pcm_read_s32le_as_s8,
+	.read_u8 	= pcm_read_s32le_as_u8,
+	.read_s16	= pcm_read_s32le_as_s16,
+	.read_u16	= pcm_read_s32le_as_u16,
+	.read_s32	= pcm_read_s32le_as_s32,
+	.read_u32	= pcm_read_s32le_as_u32,
+	.read_f32	= pcm_read_s32le_as_f32,
+	.acc_f32	= pcm_acc_s32le_as_f32,
+	.read_q15	= pcm_read_s32le_as_s16,
+	.read_q31	= pcm_read_s32le_as_s32,
+	.write_s8 	= pcm_write_s8_as_s32le,
+	.write_u8 	= pcm_write_u8_as_s32le,
+	.write_s16	= pcm_write_s16_as_s32le,
+	.write_u16	= pcm_write_u16_as_s32le,
+	.write_s32	= pcm_write_s32_as_s32le,
+	.write_u32	= pcm_write_u32_as_s32le,
+	.write_f32	= pcm_write_f32_as_s32le,
+	.write_q15	= pcm_write_s16_as_s32le,
+	.write_q31	= pcm_write_s32_as_s32le,
+};
+
+static const AUOPS pcm_s32be = {
+	.read_s8 	= pcm_read_s32be_as_s8,
+	.read_u8 	= pcm_read_s32be_as_u8,
+	.read_s16	= pcm_read_s32be_as_s16,
+	.read_u16	= pcm_read_s32be_as_u16,
+	.read_s32	= pcm_read_s32be_as_s32,
+	.read_u32	= pcm_read_s32be_as_u32,
+	.read_f32	= pcm_read_s32be_as_f32,
+	.acc_f32	= pcm_acc_s32be_as_f32,
+	.read_q15	= pcm_read_s32be_as_s16,
+	.read_q31	= pcm_read_s32be_as_s32,
+	.write_s8 	= pcm_write_s8_as_s32be,
+	.write_u8 	= pcm_write_u8_as_s32be,
+	.write_s16	= pcm_write_s16_as_s32be,
+	.write_u16	= pcm_write_u16_as_s32be,
+	.write_s32	= pcm_write_s32_as_s32be,
+	.write_u32	= pcm_write_u32_as_s32be,
+	.write_f32	= pcm_write_f32_as_s32be,
+	.write_q15	= pcm_write_s16_as_s32be,
+	.write_q31	= pcm_write_s32_as_s32be,
+};
+
+static const AUOPS pcm_u32le = {
+	.read_s8 	= pcm_read_u32le_as_s8,
+	.read_u8 	= pcm_read_u32le_as_u8,
+	.read_s16	= pcm_read_u32le_as_s16,
+	.read_u16	= pcm_read_u32le_as_u16,
+	.read_s32	= pcm_read_u32le_as_s32,
+	.read_u32	= pcm_read_u32le_as_u32,
+	.read_f32	= pcm_read_u32le_as_f32,
+	.acc_f32	= pcm_acc_u32le_as_f32,
+	.read_q15	= pcm_read_u32le_as_s16,
+	.read_q31	= pcm_read_u32le_as_s32,
+	.write_s8 	= pcm_write_s8_as_u32le,
+	.write_u8 	= pcm_write_u8_as_u32le,
+	.write_s16	= pcm_write_s16_as_u32le,
+	.write_u16	= pcm_write_u16_as_u32le,
+	.write_s32	= pcm_write_s32_as_u32le,
+	.write_u32	= pcm_write_u32_as_u32le,
+	.write_f32	= pcm_write_f32_as_u32le,
+	.write_q15	= pcm_write_s16_as_u32le,
+	.write_q31	= pcm_write_s32_as_u32le,
+};
+
+static const AUOPS pcm_u32be = {
+	.read_s8 	= pcm_read_u32be_as_s8,
+	.read_u8 	= pcm_read_u32be_as_u8,
+	.read_s16	= pcm_read_u32be_as_s16,
+	.read_u16	= pcm_read_u32be_as_u16,
+	.read_s32	= pcm_read_u32be_as_s32,
+	.read_u32	= pcm_read_u32be_as_u32,
+	.read_f32	= pcm_read_u32be_as_f32,
+	.acc_f32	= pcm_acc_u32be_as_f32,
+	.read_q15	= pcm_read_u32be_as_s16,
+	.read_q31	= pcm_read_u32be_as_s32,
+	.write_s8 	= pcm_write_s8_as_u32be,
+	.write_u8 	= pcm_write_u8_as_u32be,
+	.write_s16	= pcm_write_s16_as_u32be,
+	.write_u16	= pcm_write_u16_as_u32be,
+	.write_s32	= pcm_write_s32_as_u32be,
+	.write_u32	= pcm_write_u32_as_u32be,
+	.write_f32	= pcm_write_f32_as_u32be,
+	.write_q15	= pcm_write_s16_as_u32be,
+	.write_q31	= pcm_write_s32_as_u32be,
+};
+
+static const AUOPS pcm_f32le = {
+	.read_s8 	= pcm_read_f32le_as_s8,
+	.read_u8 	= pcm_read_f32le_as_u8,
+	.read_s16	= pcm_read_f32le_as_s16,
+	.read_u16	= pcm_read_f32le_as_u16,
+	.read_s32	= pcm_read_f32le_as_s32,
+	.read_u32	= pcm_read_f32le_as_u32,
+	.read_f32	= pcm_read_f32le_as_f32,
+	.acc_f32	= pcm_acc_f32le_as_f32,
+	.read_q15	= pcm_read_f32le_as_q15,
+	.read_q31	= pcm_read_f32le_as_q31,
+	.write_s8 	= pcm_write_s8_as_f32le,
+	.write_u8 	= pcm_write_u8_as_f32le,
+	.write_s16	= pcm_write_s16_as_f32le,
+	.write_u16	= pcm_write_u16_as_f32le,
+	.write_s32	= pcm_write_s32_as_f32le,
+	.write_u32	= pcm_write_u32_as_f32le,
+	.write_f32	= pcm_write_f32_as_f32le,
+	.write_q15	= pcm_write_q15_as_f32le,
+	.write_q31	= pcm_write_q31_as_f32le,
+};
+
+static const AUOPS pcm_f32be = {
+	.read_s8 	= pcm_read_f32be_as_s8,
+	.read_u8 	= pcm_read_f32be_as_u8,
+	.read_s16	= pcm_read_f32be_as_s16,
+	.read_u16	= pcm_read_f32be_as_u16,
+	.read_s32	= pcm_read_f32be_as_s32,
+	.read_u32	= pcm_read_f32be_as_u32,
+	.read_f32	= pcm_read_f32be_as_f32,
+	.acc_f32	= pcm_acc_f32be_as_f32,
+	.read_q15	= pcm_read_f32be_as_q15,
+	.read_q31	= pcm_read_f32be_as_q31,
+	.write_s8 	= pcm_write_s8_as_f32be,
+	.write_u8 	= pcm_write_u8_as_f32be,
+	.write_s16	= pcm_write_s16_as_f32be,
+	.write_u16	= pcm_write_u16_as_f32be,
+	.write_s32	= pcm_write_s32_as_f32be,
+	.write_u32	= pcm_write_u32_as_f32be,
+	.write_f32	= pcm_write_f32_as_f32be,
+	.write_q15	= pcm_write_q15_as_f32be,
+	.write_q31	= pcm_write_q31_as_f32be,
+};
+
+static const AUOPS pcm_half = {
+	.read_s8 	= pcm_read_half_as_s8,
+	.read_u8 	= pcm_read_half_as_u8,
+	.read_s16	= pcm_read_half_as_s16,
+	.read_u16	= pcm_read_half_as_u16,
+	.read_s32	= pcm_read_half_as_s32,
+	.read_u32	= pcm_read_half_as_u32,
+	.read_f32	= pcm_read_half_as_f32,
+	.acc_f32	= pcm_acc_half_as_f32,
+	.read_q15	= pcm_read_half_as_q15,
+	.read_q31	= pcm_read_half_as_q31,
+	.write_s8 	= pcm_write_s8_as_half,
+	.write_u8 	= pcm_write_u8_as_half,
+	.write_s16	= pcm_write_s16_as_half,
+	.write_u16	= pcm_write_u16_as_half,
+	.write_s32	= pcm_write_s32_as_half,
+	.write_u32	= pcm_write_u32_as_half,
+	.write_f32	= pcm_write_f32_as_half,
+	.write_q15	= pcm_write_q15_as_half,
+	.write_q31	= pcm_write_q31_as_half,
+};
+
+int
+pcm_init(AUFILE *file)
+{
+	if (file == NULL || file->info == NULL)
+		return -1;
+	if ((file->info->encoding & AU_ENCTYPE_MASK) != AU_ENCTYPE_PCM) {
+		warnx("Will not intitialize non PCM file as PCM");
+		return -1;
+	}
+	switch (file->info->encoding
+	& (AU_ENCODING_MASK | AU_ORDER_MASK | AU_BITSIZE_MASK)) {
+		case AU_ENCODING_SIGNED   | AU_ORDER_NONE | 8:
+			file->ops = &pcm_s8;
 			break;
 		case AU_ENCODING_UNSIGNED | AU_ORDER_NONE | 8:
-			file->au_write_s8  = pcm_write_s8_as_u8;
-			file->au_write_u8  = pcm_write_u8_as_u8;
-			file->au_write_s16 = pcm_write_s16_as_u8;
-			file->au_write_u16 = pcm_write_u16_as_u8;
-			file->au_write_s32 = pcm_write_s32_as_u8;
-			file->au_write_u32 = pcm_write_u32_as_u8;
-			file->au_write_f32 = pcm_write_f32_as_u8;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_LE | 16:
-			file->au_write_s8  = pcm_write_s8_as_s16le;
-			file->au_write_u8  = pcm_write_u8_as_s16le;
-			file->au_write_s16 = pcm_write_s16_as_s16le;
-			file->au_write_u16 = pcm_write_u16_as_s16le;
-			file->au_write_s32 = pcm_write_s32_as_s16le;
-			file->au_write_u32 = pcm_write_u32_as_s16le;
-			file->au_write_f32 = pcm_write_f32_as_s16le;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_BE | 16:
-			file->au_write_s8  = pcm_write_s8_as_s16be;
-			file->au_write_u8  = pcm_write_u8_as_s16be;
-			file->au_write_s16 = pcm_write_s16_as_s16be;
-			file->au_write_u16 = pcm_write_u16_as_s16be;
-			file->au_write_s32 = pcm_write_s32_as_s16be;
-			file->au_write_u32 = pcm_write_u32_as_s16be;
-			file->au_write_f32 = pcm_write_f32_as_s16be;
+			file->ops = &pcm_u8;
+			break;
+		case AU_ENCODING_SIGNED   | AU_ORDER_LE | 16:
+			file->ops = &pcm_s16le;
+			break;
+		case AU_ENCODING_SIGNED   | AU_ORDER_BE | 16:
+			file->ops = &pcm_s16be;
 			break;
 		case AU_ENCODING_UNSIGNED | AU_ORDER_LE | 16:
-			file->au_write_s8  = pcm_write_s8_as_u16le;
-			file->au_write_u8  = pcm_write_u8_as_u16le;
-			file->au_write_s16 = pcm_write_s16_as_u16le;
-			file->au_write_u16 = pcm_write_u16_as_u16le;
-			file->au_write_s32 = pcm_write_s32_as_u16le;
-			file->au_write_u32 = pcm_write_u32_as_u16le;
-			file->au_write_f32 = pcm_write_f32_as_u16le;
+			file->ops = &pcm_u16le;
 			break;
 		case AU_ENCODING_UNSIGNED | AU_ORDER_BE | 16:
-			file->au_write_s8  = pcm_write_s8_as_u16be;
-			file->au_write_u8  = pcm_write_u8_as_u16be;
-			file->au_write_s16 = pcm_write_s16_as_u16be;
-			file->au_write_u16 = pcm_write_u16_as_u16be;
-			file->au_write_s32 = pcm_write_s32_as_u16be;
-			file->au_write_u32 = pcm_write_u32_as_u16be;
-			file->au_write_f32 = pcm_write_f32_as_u16be;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_LE | 32:
-			file->au_write_s8  = pcm_write_s8_as_s32le;
-			file->au_write_u8  = pcm_write_u8_as_s32le;
-			file->au_write_s16 = pcm_write_s16_as_s32le;
-			file->au_write_u16 = pcm_write_u16_as_s32le;
-			file->au_write_s32 = pcm_write_s32_as_s32le;
-			file->au_write_u32 = pcm_write_u32_as_s32le;
-			file->au_write_f32 = pcm_write_f32_as_s32le;
-			break;
-		case AU_ENCODING_SIGNED | AU_ORDER_BE | 32:
-			file->au_write_s8  = pcm_write_s8_as_s32be;
-			file->au_write_u8  = pcm_write_u8_as_s32be;
-			file->au_write_s16 = pcm_write_s16_as_s32be;
-			file->au_write_u16 = pcm_write_u16_as_s32be;
-			file->au_write_s32 = pcm_write_s32_as_s32be;
-			file->au_write_u32 = pcm_write_u32_as_s32be;
-			file->au_write_f32 = pcm_write_f32_as_s32be;
+			file->ops = &pcm_u16be;
+			break;
+		case AU_ENCODING_SIGNED   | AU_ORDER_LE | 32:
+			file->ops = &pcm_s32le;
+			break;
+		case AU_ENCODING_SIGNED   | AU_ORDER_BE | 32:
+			file->ops = &pcm_s32be;
 			break;
 		case AU_ENCODING_UNSIGNED | AU_ORDER_LE | 32:
-			file->au_write_s8  = pcm_write_s8_as_u32le;
-			file->au_write_u8  = pcm_write_u8_as_u32le;
-			file->au_write_s16 = pcm_write_s16_as_u32le;
-			file->au_write_u16 = pcm_write_u16_as_u32le;
-			file->au_write_s32 = pcm_write_s32_as_u32le;
-			file->au_write_u32 = pcm_write_u32_as_u32le;
-			file->au_write_f32 = pcm_write_f32_as_u32le;
+			file->ops = &pcm_u32le;
 			break;
 		case AU_ENCODING_UNSIGNED | AU_ORDER_BE | 32:
-			file->au_write_s8  = pcm_write_s8_as_u32be;
-			file->au_write_u8  = pcm_write_u8_as_u32be;
-			file->au_write_s16 = pcm_write_s16_as_u32be;
-			file->au_write_u16 = pcm_write_u16_as_u32be;
-			file->au_write_s32 = pcm_write_s32_as_u32be;
-			file->au_write_u32 = pcm_write_u32_as_u32be;
-			file->au_write_f32 = pcm_write_f32_as_u32be;
-			break;
-		case AU_ENCODING_FLOAT | AU_ORDER_LE | 32:
-			file->au_write_s8  = pcm_write_s8_as_f32le;
-			file->au_write_u8  = pcm_write_u8_as_f32le;
-			file->au_write_s16 = pcm_write_s16_as_f32le;
-			file->au_write_u16 = pcm_write_u16_as_f32le;
-			file->au_write_s32 = pcm_write_s32_as_f32le;
-			file->au_write_u32 = pcm_write_u32_as_f32le;
-			file->au_write_f32 = pcm_write_f32_as_f32le;
-			break;
-		case AU_ENCODING_FLOAT | AU_ORDER_BE | 32:
-			file->au_write_s8  = pcm_write_s8_as_f32be;
-			file->au_write_u8  = pcm_write_u8_as_f32be;
-			file->au_write_s16 = pcm_write_s16_as_f32be;
-			file->au_write_u16 = pcm_write_u16_as_f32be;
-			file->au_write_s32 = pcm_write_s32_as_f32be;
-			file->au_write_u32 = pcm_write_u32_as_f32be;
-			file->au_write_f32 = pcm_write_f32_as_f32be;
+			file->ops = &pcm_u32be;
+			break;
+		case AU_ENCODING_FLOAT    | AU_ORDER_LE | 32:
+			file->ops = &pcm_f32le;
+			break;
+		case AU_ENCODING_FLOAT    | AU_ORDER_BE | 32:
+			file->ops = &pcm_f32be;
+			break;
+		case AU_ENCODING_FLOAT  | AU_ORDER_LE | 16:
+		case AU_ENCODING_FLOAT  | AU_ORDER_BE | 16:
+		case AU_ENCODING_BFLOAT | AU_ORDER_LE | 16:
+		case AU_ENCODING_BFLOAT | AU_ORDER_BE | 16:
+			file->ops = &pcm_half;
 			break;
 		default:
-			warnx("Don't know how to write this PCM:");
+			warnx("Don't know how to %s this PCM:",
+				file->mode == AU_READ ? "read" : "write");
 			print_encoding(file->info->encoding);
 			/* FIXME: print_encoding() should go to stderr here*/
 			return -1;
-			break;
-		}
 	}
-
 	return 0;
 }
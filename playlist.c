@@ -0,0 +1,393 @@
+#include <sys/types.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* A playlist: an AUFILE which reads a list of clips of other files
+ * one after another, as one continuous stream. A clip is a region
+ * of a source file, between its in and out points, with a gain.
+ * The frames each clip starts at in the playlist are kept in an index,
+ * so that seeking to a frame is a binary search. The sources are only
+ * opened when they are read, and no more than a given number of them
+ * are kept open: the one not read for the longest time gets closed.
+ * The playlist has AUOPS of its own, so that it is read with
+ * the usual au_read_*() routines, which read its clips in turn. */
+
+#define MIN(x,y) ((x) < (y) ? (x) : (y))
+
+struct clip {
+	char		*path;
+	uint64_t	in;		/* the first frame of the source */
+	uint64_t	len;		/* in frames */
+	float		gain;
+	AUINFO		info;		/* of the source */
+	AUFILE		*src;		/* if it is open */
+	AUFILE		*region;	/* the clip of it being read */
+	uint64_t	used;		/* when it was last read */
+};
+
+struct auplay {
+	AUINFO		info;		/* of the playlist */
+	struct clip	*clips;
+	size_t		nclips;
+	uint64_t	*start;		/* frame each clip starts at, and the end */
+	size_t		cur;		/* the clip being read */
+	uint64_t	at;		/* the frame in it to read next */
+	size_t		nopen;		/* sources open */
+	size_t		maxopen;
+	uint64_t	tick;
+};
+
+/* Open the source of a clip, as a file of the playlist's format,
+ * closing the one not read for the longest time if too many are open.
+ * Return 0 on success, -1 on error. */
+static int
+play_open(struct auplay *p, struct clip *c)
+{
+	struct clip *old = NULL;
+	size_t i;
+	if (c->src)
+		return 0;
+	if (p->nopen == p->maxopen) {
+		for (i = 0; i < p->nclips; i++)
+			if (p->clips[i].src
+			&& (old == NULL || p->clips[i].used < old->used))
+				old = &p->clips[i];
+		au_close(old->region);
+		au_close(old->src);
+		old->region = old->src = NULL;
+		p->nopen--;
+	}
+	/* Only a RAW file takes its format from info. */
+	bzero(&c->info, sizeof(AUINFO));
+	if (name2type(c->path) == AU_FILETYPE_RAW) {
+		c->info.srate = p->info.srate;
+		c->info.channels = p->info.channels;
+		c->info.encoding = p->info.encoding;
+	}
+	if ((c->src = au_open(c->path, AU_READ, &c->info)) == NULL)
+		return -1;
+	if (c->info.srate != p->info.srate
+	||  c->info.channels != p->info.channels) {
+		warnx("Cannot resample or remix '%s' into the playlist",
+			c->path);
+		au_close(c->src);
+		c->src = NULL;
+		return -1;
+	}
+	p->nopen++;
+	return 0;
+}
+
+/* Get the current clip ready to be read at p->at.
+ * Return the clip, or NULL at the end or on error. */
+static struct clip*
+play_clip(struct auplay *p, int *error)
+{
+	struct clip *c;
+	*error = 0;
+	if (p->cur == p->nclips)
+		return NULL;
+	c = &p->clips[p->cur];
+	c->used = ++p->tick;
+	if (c->region)
+		return c;
+	if (play_open(p, c) == -1
+	|| (c->region = au_open_region(c->src,
+	c->in + p->at, c->len - p->at)) == NULL) {
+		*error = 1;
+		return NULL;
+	}
+	return c;
+}
+
+/* Be done with the current clip and go on with the next one. */
+static void
+play_next(struct auplay *p)
+{
+	au_close(p->clips[p->cur].region);
+	p->clips[p->cur].region = NULL;
+	p->cur++;
+	p->at = 0;
+}
+
+/* Read len samples of the playlist into buf, size bytes each,
+ * reading every clip with get() and applying its gain with gain().
+ * Return the number of samples read, or -1 on error. */
+static ssize_t
+play_read(AUFILE *file, void *buf, size_t len, size_t size,
+	ssize_t (*get)(AUFILE*, void*, size_t),
+	void (*gain)(void*, size_t, float))
+{
+	struct auplay *p = file->play;
+	unsigned char *b = buf;
+	struct clip *c;
+	ssize_t r, tot = 0;
+	int error;
+
+	while (len) {
+		if ((c = play_clip(p, &error)) == NULL) {
+			if (error)
+				return -1;
+			break;
+		}
+		if ((r = get(c->region, b, len)) == -1)
+			return -1;
+		if (r == 0) {
+			play_next(p);
+			continue;
+		}
+		if (c->gain != 1)
+			gain(b, r, c->gain);
+		p->at += r / p->info.channels;
+		b += r * size;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+#define PLAYINT(name, type, mid, lo, hi)				\
+static ssize_t								\
+play_get_##name(AUFILE *file, void *buf, size_t len)			\
+{									\
+	return au_read_##name(file, buf, len);				\
+}									\
+									\
+static void								\
+play_gain_##name(void *buf, size_t len, float gain)			\
+{									\
+	type *s = buf;							\
+	double v;							\
+	for (; len--; s++) {						\
+		v = ((double) *s - mid) * gain + mid;			\
+		*s = v <= lo ? lo : v >= hi ? hi			\
+			: (type) (v < 0 ? v - 0.5 : v + 0.5);		\
+	}								\
+}									\
+									\
+static ssize_t								\
+play_read_##name(AUFILE *file, type *buf, size_t len)			\
+{									\
+	return play_read(file, buf, len, sizeof(type),			\
+		play_get_##name, play_gain_##name);			\
+}
+
+PLAYINT(s8,        int8_t,           0,  INT8_MIN,   INT8_MAX)
+PLAYINT(u8,       uint8_t,        0x80,         0,  UINT8_MAX)
+PLAYINT(s16,      int16_t,           0, INT16_MIN,  INT16_MAX)
+PLAYINT(u16,     uint16_t,      0x8000,         0, UINT16_MAX)
+PLAYINT(s32,      int32_t,           0, INT32_MIN,  INT32_MAX)
+PLAYINT(u32,     uint32_t, 0x80000000U,         0, UINT32_MAX)
+PLAYINT(q15,      int16_t,           0, INT16_MIN,  INT16_MAX)
+PLAYINT(q31,      int32_t,           0, INT32_MIN,  INT32_MAX)
+
+static ssize_t
+play_get_f32(AUFILE *file, void *buf, size_t len)
+{
+	return au_read_f32(file, buf, len);
+}
+
+static void
+play_gain_f32(void *buf, size_t len, float gain)
+{
+	float *s = buf;
+	for (; len--; s++)
+		*s *= gain;
+}
+
+static ssize_t
+play_read_f32(AUFILE *file, float *buf, size_t len)
+{
+	return play_read(file, buf, len, sizeof(float),
+		play_get_f32, play_gain_f32);
+}
+
+/* Accumulating needs no buffer: every clip is accumulated
+ * with its own gain times the given one. */
+static ssize_t
+play_acc_f32(AUFILE *file, float *acc, size_t len, float gain)
+{
+	struct auplay *p = file->play;
+	struct clip *c;
+	ssize_t r, tot = 0;
+	int error;
+
+	while (len) {
+		if ((c = play_clip(p, &error)) == NULL) {
+			if (error)
+				return -1;
+			break;
+		}
+		r = au_read_accumulate_f32(c->region, acc, len, gain * c->gain);
+		if (r == -1)
+			return -1;
+		if (r == 0) {
+			play_next(p);
+			continue;
+		}
+		p->at += r / p->info.channels;
+		acc += r;
+		len -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+#define PLAYNOWRITE(name, type)						\
+static ssize_t								\
+play_write_##name(AUFILE *file, const type *buf, size_t len)		\
+{									\
+	(void) buf;							\
+	(void) len;							\
+	warnx("Cannot write into the playlist '%s'", file->path);	\
+	return -1;							\
+}
+
+PLAYNOWRITE(s8,    int8_t)
+PLAYNOWRITE(u8,   uint8_t)
+PLAYNOWRITE(s16,  int16_t)
+PLAYNOWRITE(u16, uint16_t)
+PLAYNOWRITE(s32,  int32_t)
+PLAYNOWRITE(u32, uint32_t)
+PLAYNOWRITE(f32,    float)
+PLAYNOWRITE(q15,  int16_t)
+PLAYNOWRITE(q31,  int32_t)
+
+static const AUOPS play_ops = {
+	.read_s8 	= play_read_s8,
+	.read_u8 	= play_read_u8,
+	.read_s16	= play_read_s16,
+	.read_u16	= play_read_u16,
+	.read_s32	= play_read_s32,
+	.read_u32	= play_read_u32,
+	.read_f32	= play_read_f32,
+	.acc_f32	= play_acc_f32,
+	.read_q15	= play_read_q15,
+	.read_q31	= play_read_q31,
+	.write_s8 	= play_write_s8,
+	.write_u8 	= play_write_u8,
+	.write_s16	= play_write_s16,
+	.write_u16	= play_write_u16,
+	.write_s32	= play_write_s32,
+	.write_u32	= play_write_u32,
+	.write_f32	= play_write_f32,
+	.write_q15	= play_write_q15,
+	.write_q31	= play_write_q31,
+};
+
+/* Open a playlist of n clips, keeping at most maxopen of their
+ * sources open at a time. The info tells the sample rate and channels,
+ * which all the sources must have, and the encoding of RAW sources.
+ * The length of a clip whose out point is 0 is that of the rest
+ * of its source, which then needs to be opened to find out.
+ * Return NULL on error. */
+AUFILE*
+au_play_open(const AUCLIP *clips, size_t n, size_t maxopen, AUINFO *info)
+{
+	struct auplay *p;
+	struct clip *c;
+	AUFILE *file;
+	uint64_t frames;
+	size_t i;
+
+	if (clips == NULL || n == 0 || maxopen == 0 || info == NULL
+	||  info->srate == 0 || info->channels == 0)
+		return NULL;
+	if ((p = calloc(1, sizeof(struct auplay))) == NULL
+	||  (p->clips = calloc(n, sizeof(struct clip))) == NULL
+	||  (p->start = calloc(n + 1, sizeof(uint64_t))) == NULL
+	||  (file = calloc(1, sizeof(AUFILE))) == NULL
+	||  (file->path = strdup("playlist")) == NULL)
+		err(1, NULL);
+	p->info = *info;
+	p->info.filetype = AU_FILETYPE_RAW;
+	p->nclips = n;
+	p->maxopen = maxopen;
+	file->fd = -1;
+	file->mode = AU_READ;
+	file->info = &p->info;
+	file->ops = &play_ops;
+	file->play = p;
+
+	for (i = 0; i < n; i++) {
+		c = &p->clips[i];
+		if ((c->path = strdup(clips[i].path)) == NULL)
+			err(1, NULL);
+		c->in = clips[i].in;
+		c->gain = clips[i].gain;
+		if (clips[i].out) {
+			c->len = clips[i].out > c->in ? clips[i].out - c->in : 0;
+		} else {
+			if (play_open(p, c) == -1)
+				goto err;
+			frames = au_frames(c->src);
+			c->len = frames > c->in ? frames - c->in : 0;
+		}
+		p->start[i + 1] = p->start[i] + c->len;
+	}
+	p->info.frames = p->start[n];
+	p->info.samples = p->info.frames * p->info.channels;
+	p->info.seconds = (double) p->info.frames / p->info.srate;
+	return file;
+err:
+	au_play_close(file);
+	return NULL;
+}
+
+/* Go to the given frame of the playlist, finding the clip it is in
+ * with a binary search of the index. Return 0 on success, -1 on error. */
+int
+au_play_seek(AUFILE *file, uint64_t frame)
+{
+	struct auplay *p;
+	size_t lo, hi, mid;
+	if (file == NULL || (p = file->play) == NULL
+	||  frame > p->start[p->nclips])
+		return -1;
+	/* The last clip starting at or before the frame,
+	 * which is not empty. */
+	lo = 0;
+	hi = p->nclips;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (p->start[mid] <= frame)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	while (lo < p->nclips && p->start[lo + 1] <= frame)
+		lo++;
+	if (p->cur < p->nclips) {
+		au_close(p->clips[p->cur].region);
+		p->clips[p->cur].region = NULL;
+	}
+	p->cur = lo;
+	p->at = lo < p->nclips ? frame - p->start[lo] : 0;
+	return 0;
+}
+
+/* Close the sources still open and free the playlist.
+ * This is what au_close() does with a playlist. */
+int
+au_play_close(AUFILE *file)
+{
+	struct auplay *p = file->play;
+	size_t i;
+	for (i = 0; i < p->nclips; i++) {
+		au_close(p->clips[i].region);
+		au_close(p->clips[i].src);
+		free(p->clips[i].path);
+	}
+	free(p->clips);
+	free(p->start);
+	free(p);
+	free(file->path);
+	free(file);
+	return 0;
+}
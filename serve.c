@@ -0,0 +1,320 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <strings.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Serve a file being read as a file of another type, e.g. a RAW
+ * master as a WAV, in byte ranges, e.g. to answer HTTP range requests,
+ * or read it as such a virtual file, e.g. in a FUSE file system.
+ * The samples are the same in both, only the header differs:
+ * the header of the served file is made in memory, and the samples
+ * are copied straight from the file, with sendfile() where there is
+ * one, so that they never even pass through user space.
+ *
+ * The served file can also be in another encoding, e.g. a float
+ * master served as a 16-bit WAV. A byte of the served samples
+ * is then still at a known frame of the file, so any range of it
+ * is made on demand by converting only the frames it covers. */
+
+#define SERVEBUF (64 * 1024)
+#define MIN(x,y) ((x) < (y) ? (x) : (y))
+
+/* The size of a frame of the file in the given encoding. */
+static size_t
+serve_frame(AUFILE *file, uint32_t encoding)
+{
+	return file->info->channels * (encoding & AU_BITSIZE_MASK) / 8;
+}
+
+/* Make the header of the file served as the given type
+ * in the given encoding, and find how many frames it has.
+ * Return the length of the header, or -1 on error. */
+static ssize_t
+serve_hdr(AUFILE *file, AUFILETYPE type, uint32_t encoding,
+	unsigned char *hdr, uint64_t *len)
+{
+	AUFILE tmp;
+	AUINFO info;
+	struct stat sb;
+	uint64_t frames;
+	size_t size;
+
+	if (file == NULL || file->mode != AU_READ || file->parent)
+		return -1;
+	if (fstat(file->fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+		warnx("Cannot serve '%s', not a regular file", file->path);
+		return -1;
+	}
+	size = serve_frame(file, file->info->encoding);
+	frames = sb.st_size > file->data
+		? (sb.st_size - file->data) / size : 0;
+	/* There may be something else after the samples. */
+	if (file->hdr && file->info->frames < frames)
+		frames = file->info->frames;
+
+	info = *file->info;
+	info.filetype = type;
+	info.encoding = encoding;
+	info.frames = frames;
+	info.samples = frames * info.channels;
+	info.seconds = (double) frames / info.srate;
+	bzero(&tmp, sizeof(tmp));
+	tmp.path = file->path;
+	tmp.info = &info;
+	if (au_init_type(&tmp))
+		return -1;
+	*len = frames;
+	return tmp.hdr ? tmp.hdr->make(&info, hdr, AU_HDRMAX) : 0;
+}
+
+/* Copy len bytes of the file at *off into out.
+ * Return the number of bytes copied, or -1 on error. */
+static ssize_t
+serve_copy(int out, int fd, off_t *off, size_t len)
+{
+#ifdef __linux__
+	return sendfile(out, fd, off, len);
+#else
+	unsigned char buf[SERVEBUF];
+	ssize_t r, w;
+	if ((r = pread(fd, buf, MIN(len, SERVEBUF), *off)) <= 0)
+		return r;
+	if ((w = write(out, buf, r)) > 0)
+		*off += w;
+	return w;
+#endif
+}
+
+/* Return the length of the file served as the given type,
+ * or -1 on error. */
+off_t
+au_serve_size(AUFILE *file, AUFILETYPE type)
+{
+	unsigned char hdr[AU_HDRMAX];
+	uint64_t frames;
+	ssize_t h;
+	if (file == NULL || (h = serve_hdr(file, type,
+	file->info->encoding, hdr, &frames)) == -1)
+		return -1;
+	return h + frames * serve_frame(file, file->info->encoding);
+}
+
+/* Write len bytes, starting at off, of the file served
+ * as the given type into out. The file must be a regular file
+ * being read, in an encoding the type can store.
+ * Return the number of bytes written, which is less than len
+ * at the end of the served file, or -1 on error. */
+ssize_t
+au_serve_range(int out, AUFILE *file, AUFILETYPE type, off_t off, size_t len)
+{
+	unsigned char hdr[AU_HDRMAX];
+	ssize_t h, w, tot = 0;
+	uint64_t frames;
+	off_t data, src;
+
+	if (file == NULL || off < 0 || (h = serve_hdr(file, type,
+	file->info->encoding, hdr, &frames)) == -1)
+		return -1;
+	data = frames * serve_frame(file, file->info->encoding);
+	/* The header first, from memory. */
+	while (len && off < h) {
+		if ((w = write(out, hdr + off, MIN(len, (size_t)(h - off)))) == -1)
+			return -1;
+		off += w;
+		len -= w;
+		tot += w;
+	}
+	/* Then the samples, straight from the file. */
+	if (off - h >= data)
+		return tot;
+	len = MIN(len, (size_t)(data - (off - h)));
+	src = file->data + (off - h);
+	while (len) {
+		if ((w = serve_copy(out, file->fd, &src, len)) == -1)
+			return -1;
+		if (w == 0)
+			break;
+		len -= w;
+		tot += w;
+	}
+	return tot;
+}
+
+/* Read n bytes, starting at off, of the file served as the given type
+ * into buf, without changing the position of the file.
+ * Return the number of bytes read, which is less than n
+ * at the end of the served file, or -1 on error. */
+ssize_t
+au_vread(AUFILE *file, AUFILETYPE type, off_t off, void *buf, size_t n)
+{
+	unsigned char hdr[AU_HDRMAX], *p = buf;
+	ssize_t h, r, tot = 0;
+	uint64_t frames;
+	off_t data;
+	size_t m;
+
+	if (file == NULL || off < 0 || buf == NULL || (h = serve_hdr(file,
+	type, file->info->encoding, hdr, &frames)) == -1)
+		return -1;
+	data = frames * serve_frame(file, file->info->encoding);
+	if (off < h) {
+		m = MIN(n, (size_t)(h - off));
+		memcpy(p, hdr + off, m);
+		off += m;
+		p += m;
+		n -= m;
+		tot += m;
+	}
+	if (off - h >= data)
+		return tot;
+	n = MIN(n, (size_t)(data - (off - h)));
+	while (n) {
+		r = pread(file->fd, p, n, file->data + (off - h));
+		if (r == -1)
+			return -1;
+		if (r == 0)
+			break;
+		off += r;
+		p += r;
+		n -= r;
+		tot += r;
+	}
+	return tot;
+}
+
+/* Are samples in the given encoding read as one of our types?
+ * Then they only need to be put in the right byte order. */
+static int
+serve_native(uint32_t encoding)
+{
+	if ((encoding & AU_ENCTYPE_MASK) != AU_ENCTYPE_PCM)
+		return 0;
+	switch (encoding & (AU_ENCODING_MASK | AU_BITSIZE_MASK)) {
+	case AU_ENCODING_SIGNED | 8:
+	case AU_ENCODING_UNSIGNED | 8:
+	case AU_ENCODING_SIGNED | 16:
+	case AU_ENCODING_UNSIGNED | 16:
+	case AU_ENCODING_SIGNED | 32:
+	case AU_ENCODING_UNSIGNED | 32:
+	case AU_ENCODING_FLOAT | 32:
+		return 1;
+	}
+	return 0;
+}
+
+/* Read len samples of the file in the given encoding, in the machine's
+ * byte order, into buf. Return the number of samples read, or -1. */
+static ssize_t
+serve_decode(AUFILE *file, uint32_t encoding, void *buf, size_t len)
+{
+	switch (encoding & (AU_ENCODING_MASK | AU_BITSIZE_MASK)) {
+	case AU_ENCODING_SIGNED | 8:
+		return au_read_s8(file, buf, len);
+	case AU_ENCODING_UNSIGNED | 8:
+		return au_read_u8(file, buf, len);
+	case AU_ENCODING_SIGNED | 16:
+		return au_read_s16(file, buf, len);
+	case AU_ENCODING_UNSIGNED | 16:
+		return au_read_u16(file, buf, len);
+	case AU_ENCODING_SIGNED | 32:
+		return au_read_s32(file, buf, len);
+	case AU_ENCODING_UNSIGNED | 32:
+		return au_read_u32(file, buf, len);
+	case AU_ENCODING_FLOAT | 32:
+		return au_read_f32(file, buf, len);
+	}
+	return -1;
+}
+
+/* Return the length of the file served as the given type
+ * in the given encoding, or -1 on error. */
+off_t
+au_transcode_size(AUFILE *file, AUFILETYPE type, uint32_t encoding)
+{
+	unsigned char hdr[AU_HDRMAX];
+	uint64_t frames;
+	ssize_t h;
+	if (file == NULL || (h = serve_hdr(file, type,
+	encoding, hdr, &frames)) == -1)
+		return -1;
+	return h + frames * serve_frame(file, encoding);
+}
+
+/* Read n bytes, starting at off, of the file served as the given type
+ * in the given encoding into buf, converting only the frames
+ * the range covers, and without changing the position of the file.
+ * Return the number of bytes read, which is less than n
+ * at the end of the served file, or -1 on error. */
+ssize_t
+au_transcode_read(AUFILE *file, AUFILETYPE type, uint32_t encoding,
+	off_t off, void *buf, size_t n)
+{
+	unsigned char hdr[AU_HDRMAX], tmp[SERVEBUF], *p = buf;
+	uint64_t frames, frame;
+	size_t isize, osize, skip, m;
+	ssize_t h, r, tot = 0;
+	AUFILE part;
+
+	if (file == NULL || off < 0 || buf == NULL
+	|| (h = serve_hdr(file, type, encoding, hdr, &frames)) == -1)
+		return -1;
+	if (!serve_native(encoding)) {
+		warnx("Cannot transcode '%s' into %08x", file->path, encoding);
+		return -1;
+	}
+	if (off < h) {
+		m = MIN(n, (size_t)(h - off));
+		memcpy(p, hdr + off, m);
+		off += m;
+		p += m;
+		n -= m;
+		tot += m;
+	}
+
+	/* Read the samples from the frame the range starts in,
+	 * through a part of our own, so that the file stays where it is. */
+	isize = serve_frame(file, file->info->encoding);
+	osize = serve_frame(file, encoding);
+	if (osize > sizeof(tmp)) {
+		warnx("Cannot transcode '%s', its frames are too large",
+			file->path);
+		return -1;
+	}
+	frame = (off - h) / osize;
+	skip = (off - h) % osize;
+	part = *file;
+	part.parent = file;
+	part.pos = file->data + (off_t) frame * isize;
+	/* Holes read as zeros anyway; looking for them would need
+	 * a descriptor of its own, which this part cannot close,
+	 * and nor can it close an inotify of its own to follow with. */
+	part.sparse = 0;
+	part.probe = 0;
+	part.follow = 0;
+	part.notify = 0;
+	while (n && frame < frames) {
+		m = MIN(frames - frame, sizeof(tmp) / osize);
+		if ((r = serve_decode(&part, encoding, tmp,
+		m * file->info->channels)) == -1)
+			return -1;
+		if (r == 0)
+			break;
+		r /= file->info->channels;
+		au_swap_inplace(tmp, encoding, r * file->info->channels);
+		m = MIN(n, r * osize - skip);
+		memcpy(p, tmp + skip, m);
+		frame += r;
+		skip = 0;
+		p += m;
+		n -= m;
+		tot += m;
+	}
+	return tot;
+}
@@ -0,0 +1,129 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Copy one source into several outputs in one pass.
+ * The source is only read and decoded once, into float blocks.
+ * Every output has a thread of its own which encodes the blocks
+ * into the output's format and writes them, while the next block
+ * is being read; there are two blocks taking turns. */
+
+#define TEEBLOCK (16 * 1024)
+
+struct tee {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	float		*buf[2];
+	ssize_t		len[2];		/* samples in the block, 0 at the end */
+	size_t		busy[2];	/* outputs still writing the block */
+	uint64_t	blocks;		/* blocks read so far */
+	int		error;
+};
+
+struct teeout {
+	struct tee	*tee;
+	AUFILE		*file;
+	pthread_t	thread;
+};
+
+static void*
+tee_write(void *arg)
+{
+	struct teeout *out = arg;
+	struct tee *tee = out->tee;
+	uint64_t block;
+	ssize_t len, w;
+	int b;
+
+	for (block = 0; ; block++) {
+		b = block % 2;
+		pthread_mutex_lock(&tee->lock);
+		while (tee->blocks <= block)
+			pthread_cond_wait(&tee->cond, &tee->lock);
+		len = tee->len[b];
+		pthread_mutex_unlock(&tee->lock);
+		if (len <= 0)
+			break;
+		w = au_write_f32(out->file, tee->buf[b], len);
+		pthread_mutex_lock(&tee->lock);
+		if (w != len)
+			tee->error = 1;
+		tee->busy[b]--;
+		pthread_cond_broadcast(&tee->cond);
+		pthread_mutex_unlock(&tee->lock);
+	}
+	return NULL;
+}
+
+/* Read all the samples from src and write them into
+ * each of the n files in dst, in its own format.
+ * The outputs must have the same rate and channels as the source.
+ * Return the number of samples copied, or -1 on error. */
+ssize_t
+au_tee(AUFILE *src, AUFILE **dst, size_t n)
+{
+	struct teeout *out;
+	struct tee tee;
+	ssize_t r, tot = 0;
+	size_t i;
+	int b;
+
+	if (src == NULL || dst == NULL || n == 0)
+		return -1;
+	for (i = 0; i < n; i++) {
+		if (dst[i] == NULL || dst[i]->mode != AU_WRITE)
+			return -1;
+		if (dst[i]->info->srate != src->info->srate
+		||  dst[i]->info->channels != src->info->channels) {
+			warnx("Cannot resample or remix '%s' into '%s'",
+				src->path, dst[i]->path);
+			return -1;
+		}
+	}
+
+	tee.blocks = 0;
+	tee.error = 0;
+	tee.busy[0] = tee.busy[1] = 0;
+	if ((tee.buf[0] = calloc(TEEBLOCK, sizeof(float))) == NULL
+	||  (tee.buf[1] = calloc(TEEBLOCK, sizeof(float))) == NULL
+	||  (out = calloc(n, sizeof(struct teeout))) == NULL)
+		err(1, NULL);
+	pthread_mutex_init(&tee.lock, NULL);
+	pthread_cond_init(&tee.cond, NULL);
+	for (i = 0; i < n; i++) {
+		out[i].tee = &tee;
+		out[i].file = dst[i];
+		if (pthread_create(&out[i].thread, NULL, tee_write, &out[i]))
+			err(1, NULL);
+	}
+
+	do {
+		b = tee.blocks % 2;
+		pthread_mutex_lock(&tee.lock);
+		while (tee.busy[b])
+			pthread_cond_wait(&tee.cond, &tee.lock);
+		pthread_mutex_unlock(&tee.lock);
+		if ((r = au_read_f32(src, tee.buf[b], TEEBLOCK)) > 0)
+			tot += r;
+		pthread_mutex_lock(&tee.lock);
+		if (r < 0)
+			tee.error = 1;
+		tee.len[b] = r;
+		tee.busy[b] = r > 0 ? n : 0;
+		tee.blocks++;
+		pthread_cond_broadcast(&tee.cond);
+		pthread_mutex_unlock(&tee.lock);
+	} while (r > 0);
+
+	for (i = 0; i < n; i++)
+		pthread_join(out[i].thread, NULL);
+	pthread_cond_destroy(&tee.cond);
+	pthread_mutex_destroy(&tee.lock);
+	free(tee.buf[0]);
+	free(tee.buf[1]);
+	free(out);
+	return tee.error ? -1 : tot;
+}
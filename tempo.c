@@ -0,0 +1,268 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Tempo change of float samples without changing the pitch,
+ * using the WSOLA method (waveform similarity overlap-add).
+ * The output is put together from windows of TEMPOWIN milliseconds
+ * which overlap by half. The windows are taken from the input
+ * at a hop that is speed times the output hop, but each is shifted
+ * by up to a quarter window so that it best continues the previous
+ * one, which is found by cross-correlating the candidates with
+ * the natural continuation of the previous window.
+ *
+ * The input is pushed in with au_tempo_put() and the output
+ * is pulled out with au_tempo_get(), in any chunks;
+ * au_tempo_end() tells there is no more input. */
+
+#define TEMPOWIN 20
+#define COARSE 4
+
+struct autempo {
+	unsigned	channels;
+	double		speed;
+	size_t		win;		/* window, in frames */
+	size_t		hop;		/* output hop, half the window */
+	size_t		tol;		/* how far to search, in frames */
+	float		*hann;
+	float		*ola;		/* overlap-add, one window */
+	float		*in;		/* input not yet used up */
+	size_t		inlen;		/* in frames */
+	size_t		inmax;
+	uint64_t	base;		/* input frame at in[0] */
+	uint64_t	total;		/* input frames put in */
+	float		*out;		/* output ready to be taken */
+	size_t		outlen;		/* in frames */
+	size_t		outmax;
+	uint64_t	made;		/* output frames taken out */
+	uint64_t	step;		/* windows done */
+	uint64_t	prev;		/* input frame of the last window */
+	int		end;		/* no more input */
+};
+
+/* Create a tempo changer for the format described by info;
+ * a speed of 2 plays twice as fast. Return NULL on error. */
+AUTEMPO*
+au_tempo_open(const AUINFO *info, float speed)
+{
+	AUTEMPO *t;
+	size_t i;
+	if (info == NULL || info->channels == 0 || info->srate == 0)
+		return NULL;
+	if (speed <= 0) {
+		warnx("Tempo must be positive");
+		return NULL;
+	}
+	if ((t = calloc(1, sizeof(AUTEMPO))) == NULL)
+		err(1, NULL);
+	t->channels = info->channels;
+	t->speed = speed;
+	t->hop = (info->srate * TEMPOWIN / 1000 + 1) / 2;
+	if (t->hop < COARSE)
+		t->hop = COARSE;
+	t->win = 2 * t->hop;
+	t->tol = t->hop / 2;
+	if ((t->hann = calloc(t->win, sizeof(float))) == NULL
+	||  (t->ola = calloc(t->win * t->channels, sizeof(float))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < t->win; i++)
+		t->hann[i] = 0.5 - 0.5 * cos(2 * M_PI * i / t->win);
+	return t;
+}
+
+void
+au_tempo_close(AUTEMPO *t)
+{
+	if (t) {
+		free(t->hann);
+		free(t->ola);
+		free(t->in);
+		free(t->out);
+		free(t);
+	}
+}
+
+static void
+tempo_grow(float **buf, size_t *max, size_t need, unsigned channels)
+{
+	if (need <= *max)
+		return;
+	while (*max < need)
+		*max = *max ? 2 * *max : 4096;
+	*buf = reallocarray(*buf, *max * channels, sizeof(float));
+	if (*buf == NULL)
+		err(1, NULL);
+}
+
+static void
+tempo_append(AUTEMPO *t, const float *samples, size_t frames)
+{
+	tempo_grow(&t->in, &t->inmax, t->inlen + frames, t->channels);
+	if (samples)
+		memcpy(t->in + t->inlen * t->channels, samples,
+			frames * t->channels * sizeof(float));
+	else
+		memset(t->in + t->inlen * t->channels, 0,
+			frames * t->channels * sizeof(float));
+	t->inlen += frames;
+}
+
+/* How similar is the window at input frame pos
+ * to the natural continuation of the previous window. */
+static float
+tempo_corr(AUTEMPO *t, uint64_t pos)
+{
+	size_t i, len = t->hop * t->channels;
+	const float *a = t->in + (pos - t->base) * t->channels;
+	const float *b = t->in + (t->prev + t->hop - t->base) * t->channels;
+	float c = 0;
+	for (i = 0; i < len; i++)
+		c += a[i] * b[i];
+	return c;
+}
+
+/* Find the best place for the next window around nominal:
+ * first look at every COARSE-th candidate, then around the best. */
+static uint64_t
+tempo_seek(AUTEMPO *t, uint64_t nominal)
+{
+	uint64_t p, lo, hi, best;
+	float c, max;
+	lo = nominal > t->tol ? nominal - t->tol : 0;
+	hi = nominal + t->tol;
+	max = tempo_corr(t, best = lo);
+	for (p = lo + COARSE; p <= hi; p += COARSE)
+		if ((c = tempo_corr(t, p)) > max) {
+			max = c;
+			best = p;
+		}
+	lo = best > lo + COARSE ? best - COARSE + 1 : lo;
+	hi = best + COARSE - 1 < hi ? best + COARSE - 1 : hi;
+	for (p = lo; p <= hi; p++)
+		if ((c = tempo_corr(t, p)) > max) {
+			max = c;
+			best = p;
+		}
+	return best;
+}
+
+/* How many output frames make the input frames put in. */
+static uint64_t
+tempo_want(AUTEMPO *t)
+{
+	return llround(t->total / t->speed);
+}
+
+/* Add as many windows as the input we have allows. */
+static void
+tempo_run(AUTEMPO *t)
+{
+	uint64_t nominal, pos, need, keep;
+	size_t i, j, ch = t->channels;
+	const float *src;
+	float w;
+
+	for (;;) {
+		nominal = llround(t->step * t->hop * t->speed);
+		if (t->end && t->made + t->outlen >= tempo_want(t))
+			break;
+		need = t->step ? nominal + t->tol + t->win : t->win;
+		if (t->step && t->prev + t->win > need)
+			need = t->prev + t->win;
+		if (need > t->base + t->inlen) {
+			if (!t->end)
+				break;
+			tempo_append(t, NULL, need - t->base - t->inlen);
+		}
+
+		pos = t->step ? tempo_seek(t, nominal) : 0;
+		src = t->in + (pos - t->base) * ch;
+		for (i = 0; i < t->win; i++) {
+			/* The very first window does not fade in. */
+			w = (t->step == 0 && i < t->hop) ? 1.0 : t->hann[i];
+			for (j = 0; j < ch; j++)
+				t->ola[i * ch + j] += w * src[i * ch + j];
+		}
+		tempo_grow(&t->out, &t->outmax, t->outlen + t->hop, ch);
+		memcpy(t->out + t->outlen * ch, t->ola,
+			t->hop * ch * sizeof(float));
+		t->outlen += t->hop;
+		memmove(t->ola, t->ola + t->hop * ch,
+			t->hop * ch * sizeof(float));
+		memset(t->ola + t->hop * ch, 0, t->hop * ch * sizeof(float));
+		t->prev = pos;
+		t->step++;
+
+		/* Forget the input no window will need again. */
+		nominal = llround(t->step * t->hop * t->speed);
+		keep = nominal > t->tol ? nominal - t->tol : 0;
+		if (keep > t->prev + t->hop)
+			keep = t->prev + t->hop;
+		if (keep > t->base + t->inlen)
+			keep = t->base + t->inlen;
+		if (keep > t->base) {
+			t->inlen -= keep - t->base;
+			memmove(t->in, t->in + (keep - t->base) * ch,
+				t->inlen * ch * sizeof(float));
+			t->base = keep;
+		}
+	}
+}
+
+/* Push len interleaved samples in.
+ * Return the number of samples taken, or -1 on error. */
+ssize_t
+au_tempo_put(AUTEMPO *t, const float *samples, size_t len)
+{
+	if (t == NULL || samples == NULL || t->end)
+		return -1;
+	if (len % t->channels) {
+		warnx("%zu samples is not a whole number of frames", len);
+		return -1;
+	}
+	tempo_append(t, samples, len / t->channels);
+	t->total += len / t->channels;
+	tempo_run(t);
+	return len;
+}
+
+/* Tell there is no more input,
+ * so that the rest of the output can be made. */
+void
+au_tempo_end(AUTEMPO *t)
+{
+	if (t && !t->end) {
+		t->end = 1;
+		tempo_run(t);
+	}
+}
+
+/* Pull up to len interleaved samples out. Return the number
+ * of samples stored, 0 if there are none at the moment
+ * (or none at all after au_tempo_end()), or -1 on error. */
+ssize_t
+au_tempo_get(AUTEMPO *t, float *samples, size_t len)
+{
+	size_t frames;
+	uint64_t want;
+	if (t == NULL || samples == NULL)
+		return -1;
+	frames = len / t->channels;
+	if (frames > t->outlen)
+		frames = t->outlen;
+	if (t->end) {
+		want = tempo_want(t);
+		if (t->made + frames > want)
+			frames = want > t->made ? want - t->made : 0;
+	}
+	memcpy(samples, t->out, frames * t->channels * sizeof(float));
+	t->outlen -= frames;
+	memmove(t->out, t->out + frames * t->channels,
+		t->outlen * t->channels * sizeof(float));
+	t->made += frames;
+	return frames * t->channels;
+}
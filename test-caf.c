@@ -0,0 +1,199 @@
+/* Test the CAF file type:
+ * 1. Write a sine wave into a CAF file in a given encoding.
+ * 2. Open the file again knowing nothing about it.
+ * 3. Check that the header tells the right format and length.
+ * 4. Check that the samples read back are close to the wave.
+ * 5. Subtract the file from what was read, leaving nothing.
+ * 6. Repeat for every encoding CAF can store.
+ * 7. Do the same for a file of many channels at a high rate.
+ * 8. Check that opening a file as another format is an error.
+ * 9. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define NAME "test-caf.caf"
+#define RATE 48000
+#define LEN  RATE
+#define WIDE 300	/* channels */
+#define HIGH 192000	/* Hz */
+#define WLEN 100	/* frames */
+
+uint32_t encodings[] = {
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_NONE |  8,
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE   | 16,
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_BE   | 16,
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE   | 32,
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_BE   | 32,
+	AU_ENCTYPE_PCM | AU_ENCODING_FLOAT  | AU_ORDER_LE   | 16,
+	AU_ENCTYPE_PCM | AU_ENCODING_FLOAT  | AU_ORDER_BE   | 16,
+	AU_ENCTYPE_PCM | AU_ENCODING_FLOAT  | AU_ORDER_LE   | 32,
+	AU_ENCTYPE_PCM | AU_ENCODING_FLOAT  | AU_ORDER_BE   | 32,
+};
+#define NUMENCODING ((int)(sizeof(encodings) / sizeof(uint32_t)))
+
+int
+testcaf(uint32_t encoding, const float *wave, float *rbuf)
+{
+	AUINFO info;
+	AUFILE *file;
+	int i;
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = encoding;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_f32(file, wave, LEN) != LEN)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.filetype != AU_FILETYPE_CAF
+	||  info.srate != RATE
+	||  info.channels != 2
+	||  info.encoding != encoding
+	||  info.frames != LEN / 2) {
+		warnx("wrong header for %08x", encoding);
+		return 1;
+	}
+	if (au_read_f32(file, rbuf, 2 * LEN) != LEN)
+		return 1;
+	if (au_close(file))
+		return 1;
+	for (i = 0; i < LEN; i++)
+		if (fabsf(rbuf[i] - wave[i]) > 1.0 / 64) {
+			warnx("sample %d differs for %08x", i, encoding);
+			return 1;
+		}
+
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (au_read_accumulate_f32(file, rbuf, 2 * LEN, -1) != LEN)
+		return 1;
+	if (au_close(file))
+		return 1;
+	for (i = 0; i < LEN; i++)
+		if (rbuf[i] != 0) {
+			warnx("sample %d left over for %08x", i, encoding);
+			return 1;
+		}
+	return 0;
+}
+
+/* More channels than a byte holds at a rate beyond 16 bits. */
+int
+testwide(void)
+{
+	static int16_t wbuf[WIDE * WLEN], back[WIDE * WLEN + 1];
+	AUINFO info;
+	AUFILE *file;
+	int i;
+
+	for (i = 0; i < WIDE * WLEN; i++)
+		wbuf[i] = i * 7 % 65536 - 32768;
+	bzero(&info, sizeof(info));
+	info.srate = HIGH;
+	info.channels = WIDE;
+	info.encoding = encodings[1];
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_write_s16(file, wbuf, WIDE * WLEN) != WIDE * WLEN
+	||  au_close(file))
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.srate != HIGH || info.channels != WIDE
+	||  info.frames != WLEN) {
+		warnx("%u channels at %u Hz, not %d at %d",
+			info.channels, info.srate, WIDE, HIGH);
+		return 1;
+	}
+	if (au_read_s16(file, back, WIDE * WLEN + 1) != WIDE * WLEN
+	||  memcmp(back, wbuf, sizeof(wbuf))) {
+		warnx("wide samples differ");
+		return 1;
+	}
+	if (au_close(file))
+		return 1;
+
+	/* The header says what is in the file, not the caller. */
+	bzero(&info, sizeof(info));
+	info.encoding = encodings[2];
+	if (au_open(NAME, AU_READ, &info) != NULL)
+		return 1;
+	bzero(&info, sizeof(info));
+	info.encoding = encodings[1];
+	info.frames = 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  info.frames != WLEN)
+		return 1;
+	return au_close(file);
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUFILE *file;
+	float *wave, *rbuf;
+	unsigned char hdr[256];
+	size_t len;
+	FILE *fp;
+	int i;
+
+	if ((wave = calloc(LEN, sizeof(float))) == NULL
+	||  (rbuf = calloc(2 * LEN, sizeof(float))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < LEN; i++)
+		wave[i] = .5 * sin(2 * M_PI * 441 * (i/2) / RATE);
+	for (i = 0; i < NUMENCODING; i++)
+		if (testcaf(encodings[i], wave, rbuf))
+			return 1;
+	if (testwide())
+		return 1;
+
+	/* CAF cannot store unsigned samples. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 1;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_UNSIGNED | AU_ORDER_LE | 16;
+	if (au_open(NAME, AU_WRITE, &info) != NULL)
+		return 1;
+
+	/* A data chunk too short for its edit count is broken. */
+	info.encoding = encodings[1];
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL || au_close(file))
+		return 1;
+	if ((fp = fopen(NAME, "r+")) == NULL)
+		err(1, NULL);
+	len = fread(hdr, 1, sizeof(hdr), fp);
+	for (i = 0; i + 12 <= (int)len; i++)
+		if (memcmp(hdr + i, "data", 4) == 0)
+			break;
+	if (i + 12 > (int)len)
+		return 1;
+	memset(hdr + i + 4, 0, 8);
+	hdr[i + 11] = 2;
+	if (fseek(fp, 0, SEEK_SET) || fwrite(hdr, 1, len, fp) != len
+	||  fclose(fp))
+		err(1, NULL);
+	bzero(&info, sizeof(info));
+	if (au_open(NAME, AU_READ, &info) != NULL)
+		return 1;
+
+	free(wave);
+	free(rbuf);
+	return 0;
+}
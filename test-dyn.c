@@ -0,0 +1,60 @@
+/* Test the compressor/limiter:
+ * 1. Generate a stereo sine wave way above full scale.
+ * 2. Run it through a limiter with a lookahead, in blocks.
+ * 3. Check that nothing comes out above the ceiling,
+ *    and that the output is delayed by the lookahead.
+ * 4. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define RATE	48000
+#define FREQ	441
+#define LOOK	5	/* ms */
+#define BLOCK	1000	/* frames */
+
+int
+main(void)
+{
+	AUINFO info;
+	AUDYN *dyn;
+	float *wave, ceiling = powf(10.0, -1.0 / 20.0);
+	size_t i, len = 2 * RATE, look = LOOK * RATE / 1000;
+	ssize_t n;
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	if ((dyn = au_dyn_open(&info, -6, 4, -1, 1, 50, LOOK)) == NULL)
+		return 1;
+	if ((wave = calloc(len + 2 * look, sizeof(float))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < len; i += 2)
+		wave[i] = wave[i+1] = 2.0 * sin(2 * M_PI * FREQ * (i/2) / RATE);
+
+	for (i = 0; i < len; i += 2 * BLOCK)
+		if (au_dyn(dyn, wave + i, 2 * BLOCK) != 2 * BLOCK)
+			return 1;
+	if ((n = au_dyn_drain(dyn, wave + len, 2 * look)) != (ssize_t)(2*look))
+		return 1;
+	if (au_dyn_drain(dyn, wave + len, 2 * look) != 0)
+		return 1;
+
+	for (i = 0; i < 2 * look; i++)
+		if (wave[i] != 0.0)
+			return 1;
+	for (i = 0; i < len + 2 * look; i++)
+		if (fabsf(wave[i]) > ceiling) {
+			warnx("sample %zu is %f > %f", i, wave[i], ceiling);
+			return 1;
+		}
+
+	au_dyn_close(dyn);
+	free(wave);
+	return 0;
+}
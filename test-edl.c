@@ -0,0 +1,132 @@
+/* Test rendering an edit decision list:
+ * 1. Write a ramp into a WAV file of 16-bit samples,
+ *    and into a CAF file of floats.
+ * 2. Render segments of them into a WAV file, some of which
+ *    are copied as they are and some are processed,
+ *    with several threads.
+ * 3. Read the result back and check every sample.
+ * 4. Check that a file of frames too large to render is an error.
+ * 5. Return 0 iff there was no error. */
+
+#include <strings.h>
+#include <stdio.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define WAV	"test-edl.wav"
+#define CAF	"test-edl.caf"
+#define OUT	"test-edl-out.wav"
+#define WIDEOUT	"test-edl-out.caf"
+#define WIDE	(16 * 1024 + 1)	/* channels */
+#define RATE	8000
+#define LEN	1000
+#define TOTAL	(500 + 200 + 300 + LEN)
+
+AUEDIT edits[] = {
+	{ WAV, 0,   500, 1,   0,   0   },
+	{ WAV, 200, 400, .5,  0,   0   },
+	{ WAV, 0,   300, 1,   100, 100 },
+	{ CAF, 0,   0,   1,   0,   0   },
+};
+#define NUMEDITS ((int)(sizeof(edits) / sizeof(AUEDIT)))
+
+int16_t ramp[LEN], wide[WIDE];
+
+/* What the output has at the given frame. */
+float
+expect(int frame)
+{
+	float g = 1;
+	if (frame < 500)
+		return ramp[frame];
+	if ((frame -= 500) < 200)
+		return ramp[200 + frame] / 2.0;
+	if ((frame -= 200) < 300) {
+		if (frame < 100)
+			g = frame / 100.0;
+		if (300 - frame <= 100)
+			g = (300 - frame - 1) / 100.0;
+		return g * ramp[frame];
+	}
+	return ramp[frame - 300];
+}
+
+int
+writeramp(const char *path, uint32_t encoding)
+{
+	AUINFO info;
+	AUFILE *file;
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 1;
+	info.encoding = encoding;
+	if ((file = au_open(path, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_s16(file, ramp, LEN) != LEN)
+		return 1;
+	return au_close(file);
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUFILE *file;
+	int16_t buf[TOTAL];
+	float d;
+	int i;
+
+	for (i = 0; i < LEN; i++)
+		ramp[i] = 8 * (i - LEN / 2);
+	if (writeramp(WAV,
+	AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16)
+	||  writeramp(CAF,
+	AU_ENCTYPE_PCM | AU_ENCODING_FLOAT | AU_ORDER_LE | 32))
+		return 1;
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 1;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(OUT, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_edl_render(file, edits, NUMEDITS, 3) != TOTAL)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	bzero(&info, sizeof(info));
+	if ((file = au_open(OUT, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.frames != TOTAL)
+		return 1;
+	if (au_read_s16(file, buf, TOTAL) != TOTAL
+	||  au_read_s16(file, buf, 1) != 0)
+		return 1;
+	for (i = 0; i < TOTAL; i++)
+		if ((d = buf[i] - expect(i)) > 1 || d < -1) {
+			warnx("frame %d is %d, not %f", i, buf[i], expect(i));
+			return 1;
+		}
+	if (au_close(file))
+		return 1;
+
+	/* A frame does not fit into a block of 16384 samples. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = WIDE;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_FLOAT | AU_ORDER_LE | 32;
+	if ((file = au_open(CAF, AU_WRITE, &info)) == NULL
+	||  au_write_s16(file, wide, WIDE) != WIDE || au_close(file))
+		return 1;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(WIDEOUT, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_edl_render(file, edits + NUMEDITS - 1, 1, 1) != -1)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <strings.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <err.h>
 
 #include "audio.h"
@@ -11,6 +12,10 @@ main(void)
 {
 	AUINFO info;
 	AUFILE *file = NULL;
+	float buf[8] = { 0 };
+
+	/* A read past the end of the file must not wait forever. */
+	alarm(5);
 
 	bzero(&info, sizeof(info));
 	if ((file = au_open(NAME, AU_WRITE, &info)))
@@ -40,6 +45,9 @@ main(void)
 	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
 		return 1;
 
+	if (au_write_f32(file, buf, 4) != 4)
+		return 1;
+
 	if (au_close(file))
 		return 1;
 
@@ -71,6 +79,12 @@ main(void)
 	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
 		return 1;
 
+	if (au_read_f32(file, buf, 8) != 4)
+		return 1;
+
+	if (au_read_f32(file, buf, 8) != 0)
+		return 1;
+
 	if (au_close(file))
 		return 1;
 
@@ -0,0 +1,130 @@
+/* Test the read -> process -> write pipeline:
+ * 1. Write a float sine wave into a RAW file.
+ * 2. Run it through a pipeline which halves the gain,
+ *    doubles the sample rate by repeating every sample,
+ *    and delays it through a limiter's lookahead, longer than
+ *    a block and drained at the end a block at a time,
+ *    into another RAW file.
+ * 3. Read that back, and check every sample of it.
+ * 4. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define SRC	"test-graph.raw"
+#define DST	"test-graph-out.raw"
+#define RATE	8000
+#define FREQ	441
+#define LEN	10007
+#define BLOCK	1000
+#define LOOK	200	/* ms, more than a block */
+
+float wave[LEN], back[2 * LEN + RATE];
+
+ssize_t
+gain(void *arg, float *samples, size_t len, size_t max, int last)
+{
+	size_t i;
+	(void) arg;
+	(void) max;
+	(void) last;
+	for (i = 0; i < len; i++)
+		samples[i] *= 0.5;
+	return len;
+}
+
+ssize_t
+upsample(void *arg, float *samples, size_t len, size_t max, int last)
+{
+	size_t i;
+	(void) arg;
+	(void) last;
+	if (2 * len > max)
+		return -1;
+	for (i = len; i-- > 0; )
+		samples[2*i] = samples[2*i+1] = samples[i];
+	return 2 * len;
+}
+
+ssize_t
+delay(void *arg, float *samples, size_t len, size_t max, int last)
+{
+	if (last)
+		return au_dyn_drain(arg, samples, max);
+	if (au_dyn(arg, samples, len) != (ssize_t)len)
+		return -1;
+	return len;
+}
+
+AUFILE*
+openfile(const char *path, AUMODE mode, AUINFO *info, unsigned srate)
+{
+	bzero(info, sizeof(AUINFO));
+	info->srate = srate;
+	info->channels = 1;
+	info->encoding = AU_ENCTYPE_PCM | AU_ENCODING_FLOAT | AU_ORDER_LE | 32;
+	return au_open(path, mode, info);
+}
+
+int
+main(void)
+{
+	AUINFO info, sinfo, dinfo;
+	AUFILE *src, *dst;
+	AUGRAPH *graph;
+	AUDYN *dyn;
+	size_t i, look = LOOK * 2 * RATE / 1000;
+	float expect;
+	ssize_t n;
+
+	for (i = 0; i < LEN; i++)
+		wave[i] = 0.5 * sin(2 * M_PI * FREQ * i / RATE);
+	if ((src = openfile(SRC, AU_WRITE, &sinfo, RATE)) == NULL
+	||  au_write_f32(src, wave, LEN) != LEN || au_close(src))
+		return 1;
+
+	if ((src = openfile(SRC, AU_READ, &sinfo, RATE)) == NULL
+	||  (dst = openfile(DST, AU_WRITE, &dinfo, 2 * RATE)) == NULL)
+		return 1;
+	bzero(&info, sizeof(info));
+	info.srate = 2 * RATE;
+	info.channels = 1;
+	if ((dyn = au_dyn_open(&info, 0, 1, 0, 1, 50, LOOK)) == NULL)
+		return 1;
+	if ((graph = au_graph_open(src, dst, BLOCK, 2 * BLOCK, 4))
+		== NULL)
+		return 1;
+	if (au_graph_add(graph, gain, NULL)
+	||  au_graph_add(graph, upsample, NULL)
+	||  au_graph_add(graph, delay, dyn))
+		return 1;
+	if ((n = au_graph_run(graph)) != LEN) {
+		warnx("read %zd samples, not %d", n, LEN);
+		return 1;
+	}
+	au_graph_close(graph);
+	au_dyn_close(dyn);
+	if (au_close(src) || au_close(dst))
+		return 1;
+
+	if ((dst = openfile(DST, AU_READ, &dinfo, 2 * RATE)) == NULL)
+		return 1;
+	if ((n = au_read_f32(dst, back, 2 * LEN + RATE))
+		!= (ssize_t)(2 * LEN + look)) {
+		warnx("wrote %zd samples, not %zu", n, 2 * LEN + look);
+		return 1;
+	}
+	for (i = 0; i < 2 * LEN + look; i++) {
+		expect = i < look ? 0 : 0.5 * wave[(i - look) / 2];
+		if (fabsf(back[i] - expect) > 1e-6) {
+			warnx("sample %zu is %f, not %f", i, back[i], expect);
+			return 1;
+		}
+	}
+	return au_close(dst);
+}
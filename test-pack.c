@@ -0,0 +1,123 @@
+/* Test packs of clips:
+ * 1. Write a ramp into a WAV file.
+ * 2. Pack many regions of it as clips, from several threads at once,
+ *    in no order of their ids, having read into some of them first.
+ * 3. Open every clip in the pack by its id, and check its samples.
+ * 4. Check that ids not in the pack are not found,
+ *    and that a part which is not a region was not packed.
+ * 5. Return 0 iff there was no error. */
+
+#include <pthread.h>
+#include <strings.h>
+#include <stdio.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define WAV	"test-pack.wav"
+#define PACK	"test-pack.raw"
+#define RATE	8000
+#define LEN	1000
+#define CLIPS	500
+#define THREADS	4
+
+int16_t ramp[2 * LEN];
+AUPACK *pack;
+AUFILE *src;
+
+/* The clip of the given id is id % 50 frames from frame id % 900. */
+#define START(id)	((id) % 900)
+#define FRAMES(id)	((id) % 50)
+#define ID(i)		((i) * 7919 % 100003)
+
+void*
+packer(void *arg)
+{
+	AUFILE *region;
+	int16_t buf[2];
+	long t = (long) arg;
+	int i;
+	for (i = t; i < CLIPS; i += THREADS) {
+		if ((region = au_open_region(src,
+		START(ID(i)), FRAMES(ID(i)))) == NULL)
+			return src;
+		/* Where it is read up to does not change the clip. */
+		if (i % 2 && FRAMES(ID(i)) && au_read_s16(region, buf, 2) != 2)
+			return src;
+		if (au_pack_add(pack, ID(i), region) || au_close(region))
+			return src;
+	}
+	return NULL;
+}
+
+int
+main(void)
+{
+	pthread_t threads[THREADS];
+	int16_t buf[2 * 50];
+	AUINFO info;
+	AUFILE *file;
+	void *ret;
+	long t;
+	int i, j, id;
+
+	for (i = 0; i < 2 * LEN; i++)
+		ramp[i] = i;
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(WAV, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_s16(file, ramp, 2 * LEN) != 2 * LEN || au_close(file))
+		return 1;
+
+	bzero(&info, sizeof(info));
+	if ((src = au_open(WAV, AU_READ, &info)) == NULL)
+		return 1;
+	if ((pack = au_pack_open(PACK, AU_WRITE)) == NULL)
+		return 1;
+	for (t = 0; t < THREADS; t++)
+		if (pthread_create(&threads[t], NULL, packer, (void*) t))
+			return 1;
+	for (t = 0; t < THREADS; t++)
+		if (pthread_join(threads[t], &ret) || ret)
+			return 1;
+	/* A part which is not a region has no length to pack. */
+	if ((file = au_open_at(src, 0)) == NULL
+	||  au_pack_add(pack, 1, file) != -1 || au_close(file))
+		return 1;
+	if (au_pack_close(pack) || au_close(src))
+		return 1;
+
+	if ((pack = au_pack_open(PACK, AU_READ)) == NULL)
+		return 1;
+	for (i = 0; i < CLIPS; i++) {
+		id = ID(i);
+		if ((file = au_open_packed(pack, id)) == NULL) {
+			warnx("no clip %d", id);
+			return 1;
+		}
+		if (file->info->frames != (uint64_t) FRAMES(id)
+		||  file->info->channels != 2 || file->info->srate != RATE
+		||  au_read_s16(file, buf, 2 * 50) != 2 * FRAMES(id)
+		||  au_read_s16(file, buf, 2 * 50) != 0)
+			return 1;
+		if (au_close(file))
+			return 1;
+		for (j = 0; j < 2 * FRAMES(id); j++)
+			if (buf[j] != ramp[2 * START(id) + j]) {
+				warnx("clip %d differs at %d", id, j);
+				return 1;
+			}
+	}
+	if (au_open_packed(pack, 1) || au_open_packed(pack, 100003))
+		return 1;
+	if (au_pack_close(pack))
+		return 1;
+
+	/* A WAV file is not a pack. */
+	if (au_pack_open(WAV, AU_READ) != NULL)
+		return 1;
+	return 0;
+}
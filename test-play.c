@@ -0,0 +1,132 @@
+/* Test playlists:
+ * 1. Write a ramp into a 16 bit WAV file and a 32 bit CAF file.
+ * 2. Play clips of them, with gains, keeping one source open;
+ *    the playlist's 16 bit encoding must not override the CAF header.
+ * 3. Check every sample of the playlist, read as integers.
+ * 4. Seek around it, and check the samples read there.
+ * 5. Accumulate it into floats, and check those.
+ * 6. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define WAV	"test-play.wav"
+#define CAF	"test-play.caf"
+#define RATE	8000
+#define LEN	1000
+#define TOTAL	(100 + LEN + 10)
+#define S16LE	(AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16)
+#define S32BE	(AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_BE | 32)
+
+AUCLIP clips[] = {
+	{ WAV, 100, 200, 1 },
+	{ CAF, 0,   0,   2 },
+	{ WAV, 300, 300, 1 },
+	{ CAF, 50,  60,  -1 },
+};
+#define NUMCLIPS ((int)(sizeof(clips) / sizeof(AUCLIP)))
+
+int16_t ramp[LEN];
+
+/* What the playlist has at the given frame. */
+int
+expect(uint64_t frame)
+{
+	if (frame < 100)
+		return ramp[100 + frame];
+	if ((frame -= 100) < LEN)
+		return 2 * ramp[frame];
+	return -ramp[50 + frame - LEN];
+}
+
+int
+writeramp(const char *path, uint32_t encoding)
+{
+	AUINFO info;
+	AUFILE *file;
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 1;
+	info.encoding = encoding;
+	if ((file = au_open(path, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_s16(file, ramp, LEN) != LEN)
+		return 1;
+	return au_close(file);
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUFILE *file;
+	int16_t buf[TOTAL + 1];
+	float acc[TOTAL], d;
+	int i, n;
+
+	for (i = 0; i < LEN; i++)
+		ramp[i] = i - LEN / 2;
+	if (writeramp(WAV, S16LE) || writeramp(CAF, S32BE))
+		return 1;
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 1;
+	info.encoding = S16LE;
+	if ((file = au_play_open(clips, NUMCLIPS, 1, &info)) == NULL)
+		return 1;
+	if (file->info->frames != TOTAL)
+		return 1;
+
+	/* Read it all, in odd chunks. */
+	for (i = 0; i < TOTAL; i += n) {
+		n = i + 37 < TOTAL ? 37 : TOTAL - i;
+		if (au_read_s16(file, buf + i, n) != n)
+			return 1;
+	}
+	if (au_read_s16(file, buf, 1) != 0)
+		return 1;
+	for (i = 0; i < TOTAL; i++)
+		if (buf[i] != expect(i)) {
+			warnx("frame %d is %d, not %d", i, buf[i], expect(i));
+			return 1;
+		}
+
+	/* Seek into every clip, and to the very end. */
+	for (i = TOTAL - 1; i >= 0; i -= 99) {
+		if (au_play_seek(file, i))
+			return 1;
+		if (au_read_s16(file, buf, 1) != 1 || buf[0] != expect(i)) {
+			warnx("frame %d after a seek", i);
+			return 1;
+		}
+	}
+	if (au_play_seek(file, TOTAL) || au_read_s16(file, buf, 1) != 0)
+		return 1;
+	if (au_play_seek(file, TOTAL + 1) == 0)
+		return 1;
+
+	/* Accumulate it twice, at half the gain. */
+	for (i = 0; i < TOTAL; i++)
+		acc[i] = 0;
+	for (i = 0; i < 2; i++)
+		if (au_play_seek(file, 0)
+		||  au_read_accumulate_f32(file, acc, TOTAL, .5) != TOTAL)
+			return 1;
+	for (i = 0; i < TOTAL; i++)
+		if ((d = acc[i] * 32768 - expect(i)) > 1 || d < -1) {
+			warnx("accumulated frame %d", i);
+			return 1;
+		}
+
+	/* A playlist cannot be written into. */
+	if (au_write_s16(file, buf, 1) != -1)
+		return 1;
+	if (au_close(file))
+		return 1;
+	return 0;
+}
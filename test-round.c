@@ -0,0 +1,154 @@
+/* Test narrowing integer samples:
+ * 1. Write s32 samples into s16 with truncation, rounding and dither.
+ * 2. Check the rounding, and the saturation at the top.
+ * 3. Check that the dither averages out to the exact value,
+ *    and that parts of a file get noise of their own.
+ * 4. Read the s16 samples back as s8, rounded.
+ * 5. Convert between Q15/Q31 and float, rounded and saturated.
+ * 6. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define NAME "test-round.raw"
+#define LEN  10000
+
+int16_t
+narrow(AUROUND round, int32_t s)
+{
+	AUINFO info;
+	AUFILE *file;
+	int16_t r;
+	bzero(&info, sizeof(info));
+	info.srate = 48000;
+	info.channels = 1;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_rounding(file, round)
+	||  au_write_s32(file, &s, 1) != 1
+	||  au_close(file))
+		return 0;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_s16(file, &r, 1) != 1
+	||  au_close(file))
+		return 0;
+	return r;
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUFILE *file, *part[2];
+	int32_t *s;
+	int16_t *r;
+	int8_t r8;
+	float f[4] = { 0.5, -1.0, 1.5, 1.0 / 65536 * 3 };
+	int16_t q15[4];
+	int32_t q31[4];
+	double sum = 0;
+	int i;
+
+	if (narrow(AU_ROUND_TRUNC,   0x0001c000) != 1
+	||  narrow(AU_ROUND_NEAREST, 0x0001c000) != 2
+	||  narrow(AU_ROUND_NEAREST, 0x00014000) != 1
+	||  narrow(AU_ROUND_NEAREST, -0x0001c000) != -2
+	||  narrow(AU_ROUND_NEAREST, 0x7fffffff) != 32767
+	||  narrow(AU_ROUND_DITHER,  0x7fffffff) != 32767
+	||  narrow(AU_ROUND_TRUNC,   0x7fffffff) != 32767)
+		return 1;
+	if (au_rounding(NULL, AU_ROUND_NEAREST) == 0)
+		return 1;
+
+	/* A quarter LSB is lost by rounding, but not by dither. */
+	if ((s = calloc(LEN, sizeof(int32_t))) == NULL
+	||  (r = calloc(LEN, sizeof(int16_t))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < LEN; i++)
+		s[i] = 0x00014000;
+	bzero(&info, sizeof(info));
+	info.srate = 48000;
+	info.channels = 1;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_rounding(file, AU_ROUND_DITHER)
+	||  au_write_s32(file, s, LEN) != LEN
+	||  au_close(file))
+		return 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_s16(file, r, LEN) != LEN)
+		return 1;
+	for (i = 0; i < LEN; i++)
+		sum += r[i];
+	if (fabs(sum / LEN - 1.25) > 0.05)
+		return 1;
+	au_close(file);
+
+	/* Two parts written with the same samples get different noise. */
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_rounding(file, AU_ROUND_DITHER)
+	||  (part[0] = au_open_at(file, 0)) == NULL
+	||  (part[1] = au_open_at(file, LEN / 2)) == NULL
+	||  au_write_s32(part[0], s, LEN / 2) != LEN / 2
+	||  au_write_s32(part[1], s, LEN / 2) != LEN / 2
+	||  au_close(part[0]) || au_close(part[1]) || au_close(file))
+		return 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_s16(file, r, LEN) != LEN
+	||  au_close(file))
+		return 1;
+	for (i = 0; i < LEN / 2; i++)
+		if (r[i] != r[LEN / 2 + i])
+			break;
+	if (i == LEN / 2)
+		return 1;
+
+	/* Reading narrows too. */
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_rounding(file, AU_ROUND_NEAREST)
+	||  au_read_s8(file, &r8, 1) != 1
+	||  r8 != 0
+	||  au_close(file))
+		return 1;
+
+	/* Floats become fixed point by a power of two. */
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_FLOAT | AU_ORDER_BE | 32;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_write_f32(file, f, 4) != 4
+	||  au_write_q15(file, q15, 0) != 0
+	||  au_close(file))
+		return 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_q15(file, q15, 4) != 4
+	||  au_close(file))
+		return 1;
+	if (q15[0] != 16384 || q15[1] != -32768
+	||  q15[2] != 32767 || q15[3] != 2)
+		return 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_q31(file, q31, 4) != 4
+	||  au_close(file))
+		return 1;
+	if (q31[0] != 0x40000000 || q31[1] != INT32_MIN
+	||  q31[2] != INT32_MAX || q31[3] != 3 << 15)
+		return 1;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_write_q15(file, q15, 4) != 4
+	||  au_close(file))
+		return 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL
+	||  au_read_f32(file, f, 4) != 4
+	||  au_close(file))
+		return 1;
+	if (f[0] != 0.5 || f[1] != -1.0 || f[3] != 2.0 / 32768)
+		return 1;
+
+	free(s);
+	free(r);
+	return 0;
+}
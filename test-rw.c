@@ -32,7 +32,11 @@ struct encoding {
 { AU_ENCTYPE_PCM | AU_ENCODING_UNSIGNED | AU_ORDER_LE   | 32, "pcm-u32le" },
 { AU_ENCTYPE_PCM | AU_ENCODING_UNSIGNED | AU_ORDER_BE   | 32, "pcm-u32be" },
 { AU_ENCTYPE_PCM | AU_ENCODING_FLOAT    | AU_ORDER_LE   | 32, "pcm-f32le" },
-{ AU_ENCTYPE_PCM | AU_ENCODING_FLOAT    | AU_ORDER_BE   | 32, "pcm-f32be" }
+{ AU_ENCTYPE_PCM | AU_ENCODING_FLOAT    | AU_ORDER_BE   | 32, "pcm-f32be" },
+{ AU_ENCTYPE_PCM | AU_ENCODING_FLOAT    | AU_ORDER_LE   | 16, "pcm-f16le" },
+{ AU_ENCTYPE_PCM | AU_ENCODING_FLOAT    | AU_ORDER_BE   | 16, "pcm-f16be" },
+{ AU_ENCTYPE_PCM | AU_ENCODING_BFLOAT   | AU_ORDER_LE   | 16, "pcm-bf16le"},
+{ AU_ENCTYPE_PCM | AU_ENCODING_BFLOAT   | AU_ORDER_BE   | 16, "pcm-bf16be"}
 };
 #define NUMENCODING ((int)(sizeof(encodings) / sizeof(struct encoding)))
 
@@ -0,0 +1,91 @@
+/* Test writing one source into several outputs:
+ * 1. Write random 16 bit samples into a RAW file.
+ * 2. Tee that into RAW files of encodings
+ *    which hold 16 bit samples exactly.
+ * 3. Read every output back, and check it holds exactly the input.
+ * 4. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define SRC	"test-tee.raw"
+#define RATE	48000
+#define LEN	(3 * 16 * 1024 + 124)
+#define S16LE	(AU_ENCODING_SIGNED | AU_ORDER_LE | 16)
+
+struct {
+	const char	*path;
+	uint32_t	encoding;
+} outs[] = {
+	{ "test-tee-s16be.raw",	AU_ENCODING_SIGNED | AU_ORDER_BE | 16 },
+	{ "test-tee-s16le.raw",	AU_ENCODING_SIGNED | AU_ORDER_LE | 16 },
+	{ "test-tee-f32be.raw",	AU_ENCODING_FLOAT  | AU_ORDER_BE | 32 },
+	{ "test-tee-f32le.raw",	AU_ENCODING_FLOAT  | AU_ORDER_LE | 32 },
+};
+#define NUMOUTS ((int)(sizeof(outs) / sizeof(outs[0])))
+
+int16_t wave[LEN], back[LEN + 1];
+AUINFO info[NUMOUTS + 1];
+
+AUFILE*
+openfile(const char *path, AUMODE mode, uint32_t encoding, AUINFO *info)
+{
+	bzero(info, sizeof(AUINFO));
+	info->srate = RATE;
+	info->channels = 2;
+	info->encoding = AU_ENCTYPE_PCM | encoding;
+	return au_open(path, mode, info);
+}
+
+int
+main(void)
+{
+	AUFILE *src, *dst[NUMOUTS];
+	ssize_t r;
+	int i, o;
+
+	for (i = 0; i < LEN; i++)
+		wave[i] = rand() % 65536 - 32768;
+	if ((src = openfile(SRC, AU_WRITE, S16LE, &info[NUMOUTS])) == NULL
+	||  au_write_s16(src, wave, LEN) != LEN || au_close(src))
+		return 1;
+
+	if ((src = openfile(SRC, AU_READ, S16LE, &info[NUMOUTS])) == NULL)
+		return 1;
+	for (o = 0; o < NUMOUTS; o++)
+		if ((dst[o] = openfile(outs[o].path, AU_WRITE,
+			outs[o].encoding, &info[o])) == NULL)
+			return 1;
+	if ((r = au_tee(src, dst, NUMOUTS)) != LEN) {
+		warnx("teed %zd samples, not %d", r, LEN);
+		return 1;
+	}
+	if (au_close(src))
+		return 1;
+	for (o = 0; o < NUMOUTS; o++)
+		if (au_close(dst[o]))
+			return 1;
+
+	for (o = 0; o < NUMOUTS; o++) {
+		if ((src = openfile(outs[o].path, AU_READ,
+			outs[o].encoding, &info[o])) == NULL)
+			return 1;
+		if (au_read_s16(src, back, LEN + 1) != LEN) {
+			warnx("'%s' is not %d samples long", outs[o].path, LEN);
+			return 1;
+		}
+		for (i = 0; i < LEN; i++)
+			if (back[i] != wave[i]) {
+				warnx("sample %d of '%s' is %d, not %d", i,
+					outs[o].path, back[i], wave[i]);
+				return 1;
+			}
+		if (au_close(src))
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,91 @@
+/* Test the tempo changer:
+ * 1. Generate a stereo sine wave.
+ * 2. Change its tempo at several speeds, putting it in
+ *    and getting it out in chunks of different sizes.
+ * 3. Check that the output is as many frames as the input
+ *    divided by the speed, and about as loud.
+ * 4. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define RATE	48000
+#define FREQ	441
+#define AMP	0.5
+#define LEN	RATE	/* frames */
+#define PUT	777	/* frames */
+#define GET	1000	/* frames */
+#define TOL	2	/* frames */
+
+float speeds[] = { 0.5, 0.8, 1.0, 1.25, 2.0 };
+#define NUMSPEEDS ((int)(sizeof(speeds) / sizeof(float)))
+
+int
+main(void)
+{
+	AUINFO info;
+	AUTEMPO *tempo;
+	float *wave, *out, peak;
+	size_t i, n, len = 2 * LEN, max = 4 * len, got;
+	long want;
+	ssize_t r;
+	int s;
+
+	if ((wave = calloc(len, sizeof(float))) == NULL
+	||  (out = calloc(max, sizeof(float))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < len; i += 2)
+		wave[i] = wave[i+1] = AMP * sin(2 * M_PI * FREQ * (i/2) / RATE);
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	for (s = 0; s < NUMSPEEDS; s++) {
+		if ((tempo = au_tempo_open(&info, speeds[s])) == NULL)
+			return 1;
+		got = 0;
+		for (i = 0; i < len; i += n) {
+			n = len - i < 2 * PUT ? len - i : 2 * PUT;
+			if (au_tempo_put(tempo, wave + i, n) != (ssize_t)n)
+				return 1;
+			while ((r = au_tempo_get(tempo, out + got, 2 * GET)) > 0)
+				if ((got += r) + 2 * GET > max)
+					return 1;
+			if (r == -1)
+				return 1;
+		}
+		au_tempo_end(tempo);
+		while ((r = au_tempo_get(tempo, out + got, 2 * GET)) > 0)
+			if ((got += r) + 2 * GET > max)
+				return 1;
+		if (r == -1 || got % 2)
+			return 1;
+		if (au_tempo_put(tempo, wave, 2) != -1)
+			return 1;
+		au_tempo_close(tempo);
+
+		want = lround(LEN / speeds[s]);
+		if (labs((long)(got / 2) - want) > TOL) {
+			warnx("%zu frames at %.2fx, not %ld",
+				got / 2, speeds[s], want);
+			return 1;
+		}
+		/* Away from the ends, the sine is as loud as it was. */
+		for (peak = 0, i = got / 4; i < 3 * got / 4; i++)
+			if (fabsf(out[i]) > peak)
+				peak = fabsf(out[i]);
+		if (peak < 0.9 * AMP || peak > 1.1 * AMP) {
+			warnx("peak %f at %.2fx, not %f", peak, speeds[s], AMP);
+			return 1;
+		}
+	}
+
+	free(wave);
+	free(out);
+	return 0;
+}
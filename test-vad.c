@@ -0,0 +1,116 @@
+/* Test the voice activity detector:
+ * 1. Generate stereo noise with two bursts of a loud tone in it.
+ * 2. Feed it to the detector in chunks which split blocks and frames.
+ * 3. Check that the segments of speech are where the tones are,
+ *    each held for the hangover after it.
+ * 4. Do the same with au_vad_filter(), and check what it keeps.
+ * 5. Return 0 iff there was no error. */
+
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define RATE	8000
+#define FREQ	440
+#define HANG	100	/* ms */
+#define CHUNK	999	/* samples, an odd number */
+#define LEN	(28000 + 50)
+
+struct { uint64_t start, end; } tones[] = {
+	{  4000, 12000 },
+	{ 20000, 24000 },
+};
+#define NUMTONES ((int)(sizeof(tones) / sizeof(tones[0])))
+
+int
+check(AUVAD *vad)
+{
+	uint64_t hang = HANG * RATE / 1000;
+	AUSEG seg;
+	int i;
+	for (i = 0; i < NUMTONES; i++) {
+		if (au_vad_segment(vad, &seg) == 0) {
+			warnx("segment %d is missing", i);
+			return 1;
+		}
+		if (seg.start != tones[i].start
+		||  seg.end != tones[i].end + hang) {
+			warnx("segment %d is %ju-%ju, not %ju-%ju", i,
+				(uintmax_t)seg.start, (uintmax_t)seg.end,
+				(uintmax_t)tones[i].start,
+				(uintmax_t)(tones[i].end + hang));
+			return 1;
+		}
+	}
+	return au_vad_segment(vad, &seg);
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUVAD *vad;
+	int16_t *wave, *copy;
+	size_t i, n, len = 2 * LEN, kept = 0, block;
+	ssize_t k;
+	int t;
+
+	if ((wave = calloc(len, sizeof(int16_t))) == NULL
+	||  (copy = calloc(len, sizeof(int16_t))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < len; i++)
+		wave[i] = rand() % 17 - 8;
+	for (t = 0; t < NUMTONES; t++)
+		for (i = tones[t].start; i < tones[t].end; i++)
+			wave[2*i] = wave[2*i+1] =
+				16000 * sin(2 * M_PI * FREQ * i / RATE);
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	if ((vad = au_vad_open(&info, -30, 1000, HANG)) == NULL)
+		return 1;
+	for (i = 0; i < len; i += n) {
+		n = len - i < CHUNK ? len - i : CHUNK;
+		if (au_vad(vad, wave + i, n) != (ssize_t)n)
+			return 1;
+	}
+	au_vad_end(vad);
+	if (check(vad))
+		return 1;
+	au_vad_close(vad);
+
+	if ((vad = au_vad_open(&info, -30, 1000, HANG)) == NULL)
+		return 1;
+	block = au_vad_block(vad);
+	for (i = 0; i < len; i += n) {
+		n = len - i < CHUNK ? len - i : CHUNK;
+		memcpy(copy, wave + i, n * sizeof(int16_t));
+		if ((k = au_vad_filter(vad, copy, n)) < 0 || (size_t)k > n)
+			return 1;
+		kept += k;
+	}
+	au_vad_end(vad);
+	if (check(vad))
+		return 1;
+	au_vad_close(vad);
+
+	/* Give or take a partial block where speech starts and ends. */
+	n = 0;
+	for (t = 0; t < NUMTONES; t++)
+		n += 2 * (tones[t].end - tones[t].start + HANG * RATE / 1000);
+	block *= 2 * NUMTONES;
+	if (kept + block < n || kept > n + block) {
+		warnx("kept %zu samples, not about %zu", kept, n);
+		return 1;
+	}
+
+	free(wave);
+	free(copy);
+	return 0;
+}
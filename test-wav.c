@@ -0,0 +1,420 @@
+/* Test the WAV file type:
+ * 1. Write a recording with checkpoints, and look at it
+ *    from another handle while it is being written.
+ * 2. Let it die without closing, then recover it.
+ * 3. Write and close a file properly, and read it back.
+ * 4. Write a file in parts, from several threads at once,
+ *    and read regions of it.
+ * 5. Write a sparse file of mostly silence, and read it back,
+ *    reading a part of it on the way.
+ * 6. Serve a RAW file as a WAV, whole and in ranges,
+ *    read it as a virtual WAV, and transcode it into a float WAV;
+ *    a file of frames too large to transcode is an error.
+ * 7. Follow a recording from start to end while it is being written.
+ * 8. Write a file of many channels at a high rate, and read it back.
+ * 9. Return 0 iff there was no error. */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <err.h>
+
+#include "audio.h"
+
+#define NAME	"test-wav.wav"
+#define RAW	"test-wav.raw"
+#define RATE	8000
+#define BLOCK	1000	/* frames */
+#define BLOCKS	35
+#define PARTS	4
+#define WIDE	300	/* channels */
+#define HIGH	192000	/* Hz */
+
+int16_t wave[2 * BLOCK];
+int16_t silence[2 * BLOCK];
+int16_t wide[WIDE * BLOCK / 10], back[WIDE * BLOCK / 10 + 1];
+
+/* Open the file knowing nothing about it and see how long it is. */
+uint32_t
+frames(void)
+{
+	AUINFO info;
+	AUFILE *file;
+	uint32_t n;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 0;
+	n = info.frames;
+	if (info.srate != RATE || info.channels != 2
+	||  info.encoding != (AU_ENCTYPE_PCM|AU_ENCODING_SIGNED|AU_ORDER_LE|16))
+		n = 0;
+	au_close(file);
+	return n;
+}
+
+/* Write a block into a part of a file. */
+void*
+part(void *arg)
+{
+	AUFILE *file = arg;
+	if (au_write_s16(file, wave, 2 * BLOCK) != 2 * BLOCK)
+		return file;
+	return NULL;
+}
+
+/* Record blocks in real time, more or less. */
+void*
+record(void *arg)
+{
+	struct timespec ts = { 0, 5000000 };
+	AUFILE *file = arg;
+	int i;
+	for (i = 0; i < BLOCKS; i++) {
+		nanosleep(&ts, NULL);
+		if (au_write_s16(file, wave, 2 * BLOCK) != 2 * BLOCK)
+			return file;
+	}
+	if (au_close(file))
+		return file;
+	return NULL;
+}
+
+int
+main(void)
+{
+	AUINFO info;
+	AUFILE *file, *parts[PARTS];
+	struct stat sb;
+	pthread_t threads[PARTS];
+	float rbuf[2 * BLOCK], tbuf[2 * BLOCK];
+	unsigned char vbuf[44 + 4 * BLOCK], sbuf[44 + 4 * BLOCK + 1];
+	void *ret;
+	uint32_t enc;
+	ssize_t n;
+	off_t off;
+	int i, fd;
+
+	for (i = 0; i < 2 * BLOCK; i++)
+		wave[i] = 10000 * sin(2 * M_PI * 441 * (i/2) / RATE);
+
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_checkpoint(file, 1))
+		return 1;
+	for (i = 0; i < BLOCKS; i++)
+		if (au_write_s16(file, wave, 2 * BLOCK) != 2 * BLOCK)
+			return 1;
+	/* The last checkpoint was at 4 seconds of audio. */
+	if (frames() != 4 * RATE)
+		return 1;
+
+	/* Die in the middle of a frame. */
+	if (write(file->fd, wave, 3) != 3)
+		return 1;
+	close(file->fd);
+	if (au_recover(NAME))
+		return 1;
+	if (frames() != BLOCKS * BLOCK)
+		return 1;
+
+	/* Write it properly. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_s16(file, wave, 2 * BLOCK) != 2 * BLOCK)
+		return 1;
+	if (au_close(file))
+		return 1;
+	if (frames() != BLOCK)
+		return 1;
+	/* The header says what is in the file: what we expect
+	 * has to agree with it, and the length is never ours. */
+	bzero(&info, sizeof(info));
+	info.channels = 1;
+	if (au_open(NAME, AU_READ, &info) != NULL)
+		return 1;
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.frames = 1;
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.frames != BLOCK)
+		return 1;
+	if (au_read_f32(file, rbuf, 2 * BLOCK) != 2 * BLOCK)
+		return 1;
+	for (i = 0; i < 2 * BLOCK; i++)
+		if (fabsf(rbuf[i] * 32767 - wave[i]) > 1)
+			return 1;
+	if (au_read_f32(file, rbuf, 2 * BLOCK) != 0)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	/* Write the parts in reverse order of their position. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	for (i = PARTS - 1; i >= 0; i--) {
+		if ((parts[i] = au_open_at(file, i * BLOCK)) == NULL)
+			return 1;
+		if (pthread_create(&threads[i], NULL, part, parts[i]))
+			return 1;
+	}
+	for (i = 0; i < PARTS; i++) {
+		if (pthread_join(threads[i], &ret) || ret)
+			return 1;
+		if (au_close(parts[i]))
+			return 1;
+	}
+	if (au_close(file))
+		return 1;
+	if (frames() != PARTS * BLOCK)
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	for (i = 0; i < PARTS; i++) {
+		if (au_read_f32(file, rbuf, 2 * BLOCK) != 2 * BLOCK)
+			return 1;
+		if (fabsf(rbuf[2 * BLOCK - 1] * 32767 - wave[2 * BLOCK - 1]) > 1)
+			return 1;
+	}
+	/* A region across two parts, and one going past the end. */
+	if ((parts[0] = au_open_region(file, BLOCK / 2, BLOCK)) == NULL
+	||  (parts[1] = au_open_region(file, (PARTS - 1) * BLOCK, 2 * BLOCK))
+		== NULL)
+		return 1;
+	if (parts[0]->info->frames != BLOCK || parts[1]->info->frames != BLOCK)
+		return 1;
+	if (au_read_f32(parts[0], rbuf, 2 * BLOCK) != 2 * BLOCK
+	||  au_read_f32(parts[0], rbuf, 2 * BLOCK) != 0)
+		return 1;
+	for (i = 0; i < 2 * BLOCK; i++)
+		if (fabsf(rbuf[i] * 32767 - wave[(i + BLOCK) % (2 * BLOCK)]) > 1)
+			return 1;
+	if (au_read_f32(parts[1], rbuf, 2 * BLOCK) != 2 * BLOCK
+	||  au_read_f32(parts[1], rbuf, 2 * BLOCK) != 0)
+		return 1;
+	if (au_close(parts[0]) || au_close(parts[1]) || au_close(file))
+		return 1;
+
+	/* Silence around a block of sound, up to the end,
+	 * is left out as holes, but still reads back as zeros. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_sparse(file, 1))
+		return 1;
+	for (i = 0; i < BLOCKS; i++)
+		if (au_write_s16(file, i == 1 ? wave : silence,
+		2 * BLOCK) != 2 * BLOCK)
+			return 1;
+	if (au_close(file))
+		return 1;
+	if (frames() != BLOCKS * BLOCK)
+		return 1;
+	if (stat(NAME, &sb) == -1 || sb.st_blocks * 512 >= sb.st_size / 2)
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (au_sparse(file, 1))
+		return 1;
+	for (i = 0; i < BLOCKS; i++) {
+		/* Reading a part must not move the file. */
+		if (i == 1) {
+			if ((parts[0] = au_open_at(file, BLOCK)) == NULL
+			||  au_read_f32(parts[0], tbuf, 2 * BLOCK) != 2 * BLOCK
+			||  au_close(parts[0]))
+				return 1;
+		}
+		if (au_read_f32(file, rbuf, 2 * BLOCK) != 2 * BLOCK)
+			return 1;
+		if (fabsf(rbuf[2 * BLOCK - 1] * 32767
+		- (i == 1 ? wave[2 * BLOCK - 1] : 0)) > 1)
+			return 1;
+	}
+	if (au_read_f32(file, rbuf, 2 * BLOCK) != 0)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	/* A RAW file served as a WAV is a WAV of the same samples,
+	 * and any range of it is the same bytes. */
+	bzero(&info, sizeof(info));
+	info.filetype = AU_FILETYPE_RAW;
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(RAW, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_write_s16(file, wave, 2 * BLOCK) != 2 * BLOCK)
+		return 1;
+	if (au_close(file))
+		return 1;
+	if ((file = au_open(RAW, AU_READ, &info)) == NULL)
+		return 1;
+	/* A region of a RAW file ends where the file does too. */
+	if ((parts[0] = au_open_region(file, BLOCK / 2, 2 * BLOCK)) == NULL
+	||  parts[0]->info->frames != BLOCK / 2
+	||  au_close(parts[0]))
+		return 1;
+	if (au_serve_size(file, AU_FILETYPE_WAV) != 44 + 4 * BLOCK)
+		return 1;
+	if ((fd = open(NAME, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+		return 1;
+	if (au_serve_range(fd, file, AU_FILETYPE_WAV, 0, 10) != 10
+	||  au_serve_range(fd, file, AU_FILETYPE_WAV, 10, 100) != 100
+	||  au_serve_range(fd, file, AU_FILETYPE_WAV, 110, SIZE_MAX)
+		!= 44 + 4 * BLOCK - 110
+	||  au_serve_range(fd, file, AU_FILETYPE_WAV, 44 + 4 * BLOCK, 1) != 0)
+		return 1;
+	close(fd);
+	if (au_vread(file, AU_FILETYPE_WAV, 0, vbuf, 30) != 30
+	||  au_vread(file, AU_FILETYPE_WAV, 30, vbuf + 30, sizeof(vbuf) - 30)
+		!= 44 + 4 * BLOCK - 30)
+		return 1;
+	if (au_close(file))
+		return 1;
+	if (frames() != BLOCK)
+		return 1;
+	if ((fd = open(NAME, O_RDONLY)) == -1
+	||  read(fd, sbuf, sizeof(sbuf)) != 44 + 4 * BLOCK
+	||  memcmp(vbuf, sbuf, 44 + 4 * BLOCK))
+		return 1;
+	close(fd);
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (au_read_f32(file, rbuf, 2 * BLOCK) != 2 * BLOCK)
+		return 1;
+	for (i = 0; i < 2 * BLOCK; i++)
+		if (fabsf(rbuf[i] * 32767 - wave[i]) > 1)
+			return 1;
+	if (au_close(file))
+		return 1;
+
+	/* Transcoded into floats, in ranges that split the samples,
+	 * it reads the same as the RAW file does. */
+	info.filetype = AU_FILETYPE_RAW;
+	if ((file = au_open(RAW, AU_READ, &info)) == NULL)
+		return 1;
+	enc = AU_ENCTYPE_PCM | AU_ENCODING_FLOAT | AU_ORDER_LE | 32;
+	if (au_transcode_size(file, AU_FILETYPE_WAV, enc) != 44 + 8 * BLOCK)
+		return 1;
+	if ((fd = open(NAME, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+		return 1;
+	for (off = 0; (n = au_transcode_read(file,
+	AU_FILETYPE_WAV, enc, off, vbuf, 999)) > 0; off += n)
+		if (write(fd, vbuf, n) != n)
+			return 1;
+	close(fd);
+	if (n != 0 || off != 44 + 8 * BLOCK || au_close(file))
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.encoding != enc
+	||  au_read_f32(file, tbuf, 2 * BLOCK) != 2 * BLOCK
+	||  memcmp(rbuf, tbuf, sizeof(tbuf)))
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	/* A frame too large to be transcoded at once is an error. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 20000;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(RAW, AU_WRITE, &info)) == NULL
+	||  au_close(file)
+	||  (file = au_open(RAW, AU_READ, &info)) == NULL)
+		return 1;
+	if (au_transcode_read(file, AU_FILETYPE_CAF, enc, 0, vbuf, 999) != -1
+	||  au_close(file))
+		return 1;
+
+	/* Read the recording as it goes, until it is closed. */
+	bzero(&info, sizeof(info));
+	info.srate = RATE;
+	info.channels = 2;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL)
+		return 1;
+	if (au_checkpoint(file, 1))
+		return 1;
+	if (pthread_create(&threads[0], NULL, record, file))
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (au_follow(file, 5000))
+		return 1;
+	/* Its parts do not follow it. */
+	if ((parts[0] = au_open_at(file, 0)) == NULL
+	||  parts[0]->follow || parts[0]->notify || au_close(parts[0]))
+		return 1;
+	for (i = 0; (n = au_read_f32(file, rbuf, 2 * BLOCK)) > 0; i += n)
+		if (fabsf(rbuf[n - 1] * 32767
+		- wave[(i + n - 1) % (2 * BLOCK)]) > 1)
+			return 1;
+	if (n != 0 || i != BLOCKS * 2 * BLOCK)
+		return 1;
+	if (pthread_join(threads[0], &ret) || ret)
+		return 1;
+	if (info.frames != BLOCKS * BLOCK)
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	/* More channels than a byte holds at a rate beyond 16 bits. */
+	for (i = 0; i < WIDE * BLOCK / 10; i++)
+		wide[i] = i * 7 % 65536 - 32768;
+	bzero(&info, sizeof(info));
+	info.srate = HIGH;
+	info.channels = WIDE;
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_LE | 16;
+	if ((file = au_open(NAME, AU_WRITE, &info)) == NULL
+	||  au_write_s16(file, wide, WIDE * BLOCK / 10) != WIDE * BLOCK / 10
+	||  au_close(file))
+		return 1;
+	bzero(&info, sizeof(info));
+	if ((file = au_open(NAME, AU_READ, &info)) == NULL)
+		return 1;
+	if (info.srate != HIGH || info.channels != WIDE
+	||  info.frames != BLOCK / 10)
+		return 1;
+	if (au_read_s16(file, back, WIDE * BLOCK / 10 + 1) != WIDE * BLOCK / 10
+	||  memcmp(back, wide, sizeof(wide)))
+		return 1;
+	if (au_close(file))
+		return 1;
+
+	/* WAV cannot store big-endian samples. */
+	info.encoding = AU_ENCTYPE_PCM | AU_ENCODING_SIGNED | AU_ORDER_BE | 16;
+	if (au_open(NAME, AU_WRITE, &info) != NULL)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,227 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+
+#include "audio.h"
+
+/* Voice activity detection on signed 16 bit samples,
+ * as they come from au_read_s16(). The input is cut into
+ * analysis blocks of VADBLOCK milliseconds. A block is speech
+ * if it is loud enough (voiced sounds), or if it is not quite
+ * that loud but crosses zero often (unvoiced sounds, fricatives).
+ * A segment of speech lasts until there has been no speech
+ * for the hangover time, so that short pauses do not split it.
+ * Segments are reported in frames. A partial block at the end
+ * of the input is kept until the next call completes it,
+ * or until au_vad_end() analyzes what there is of it. */
+
+#define VADBLOCK 20
+
+struct auvad {
+	unsigned	channels;
+	size_t		block;		/* analysis block, in samples */
+	double		thresh;		/* energy threshold, mean square */
+	double		zcr;		/* crossings per sample */
+	size_t		hang;		/* hangover, in blocks */
+	size_t		quiet;		/* blocks since the last speech */
+	int		speech;		/* are we in a segment? */
+	uint64_t	pos;		/* frames analyzed */
+	int16_t		*part;		/* a partial block, waiting for more */
+	size_t		npart;
+	AUSEG		seg;		/* the segment we are in */
+	AUSEG		*segs;		/* finished segments */
+	size_t		head;		/* the first one not yet reported */
+	size_t		nsegs;
+	size_t		maxsegs;
+};
+
+/* Create a voice activity detector for the format described by info.
+ * Blocks above thresh (dBFS) are speech; so are blocks less than
+ * 18 dB below that which cross zero more than zcr times a second.
+ * Segments are kept open for hangover milliseconds after speech.
+ * Return NULL on error. */
+AUVAD*
+au_vad_open(const AUINFO *info, float thresh, float zcr, float hangover)
+{
+	AUVAD *vad;
+	if (info == NULL || info->channels == 0 || info->srate == 0)
+		return NULL;
+	if ((vad = calloc(1, sizeof(AUVAD))) == NULL)
+		err(1, NULL);
+	vad->channels = info->channels;
+	vad->block  = info->channels * (info->srate * VADBLOCK / 1000);
+	vad->thresh = pow(10.0, thresh / 10.0) * INT16_MAX * INT16_MAX;
+	vad->zcr    = zcr / info->srate;
+	vad->hang   = hangover > 0 ? hangover / VADBLOCK : 0;
+	if (vad->block == 0)
+		vad->block = info->channels;
+	if ((vad->part = calloc(vad->block, sizeof(int16_t))) == NULL)
+		err(1, NULL);
+	return vad;
+}
+
+void
+au_vad_close(AUVAD *vad)
+{
+	if (vad) {
+		free(vad->part);
+		free(vad->segs);
+		free(vad);
+	}
+}
+
+/* The number of samples in an analysis block. */
+size_t
+au_vad_block(const AUVAD *vad)
+{
+	return vad ? vad->block : 0;
+}
+
+static void
+vad_push(AUVAD *vad)
+{
+	if (vad->head == vad->nsegs)
+		vad->head = vad->nsegs = 0;
+	if (vad->nsegs == vad->maxsegs) {
+		vad->maxsegs = vad->maxsegs ? 2 * vad->maxsegs : 16;
+		vad->segs = reallocarray(vad->segs,
+			vad->maxsegs, sizeof(AUSEG));
+		if (vad->segs == NULL)
+			err(1, NULL);
+	}
+	vad->segs[vad->nsegs++] = vad->seg;
+	vad->speech = 0;
+}
+
+/* Analyze a block of len samples and update the segments.
+ * Return 1 if the block is to be kept, i.e. if it is
+ * within a segment of speech, 0 otherwise. */
+static int
+vad_block(AUVAD *vad, const int16_t *samples, size_t len)
+{
+	size_t i, cross = 0, frames = len / vad->channels;
+	int64_t energy = 0;
+	double e, z;
+
+	if (frames == 0)
+		return vad->speech;
+	len = frames * vad->channels;
+	for (i = 0; i < len; i++)
+		energy += (int32_t)samples[i] * samples[i];
+	for (i = vad->channels; i < len; i++)
+		cross += (samples[i] ^ samples[i - vad->channels]) < 0;
+	e = (double)energy / len;
+	z = (double)cross / len;
+
+	if (e >= vad->thresh || (e >= vad->thresh / 64 && z >= vad->zcr)) {
+		if (!vad->speech) {
+			vad->speech = 1;
+			vad->seg.start = vad->pos;
+		}
+		vad->quiet = 0;
+	} else if (vad->speech && ++vad->quiet > vad->hang) {
+		vad_push(vad);
+	}
+	vad->pos += frames;
+	if (vad->speech)
+		vad->seg.end = vad->pos;
+	return vad->speech;
+}
+
+/* Add up to len samples to the partial block, and analyze it
+ * once it is complete. Return the number of samples taken;
+ * the block's verdict, or the current one if it is still
+ * partial, is stored into keep. */
+static size_t
+vad_part(AUVAD *vad, const int16_t *samples, size_t len, int *keep)
+{
+	size_t n = vad->block - vad->npart;
+	if (n > len)
+		n = len;
+	memcpy(vad->part + vad->npart, samples, n * sizeof(int16_t));
+	if ((vad->npart += n) == vad->block) {
+		*keep = vad_block(vad, vad->part, vad->block);
+		vad->npart = 0;
+	} else {
+		*keep = vad->speech;
+	}
+	return n;
+}
+
+/* Analyze len interleaved samples.
+ * Return the number of samples taken, or -1 on error. */
+ssize_t
+au_vad(AUVAD *vad, const int16_t *samples, size_t len)
+{
+	size_t i = 0;
+	int keep;
+	if (vad == NULL || samples == NULL)
+		return -1;
+	if (vad->npart)
+		i = vad_part(vad, samples, len, &keep);
+	for (; len - i >= vad->block; i += vad->block)
+		vad_block(vad, samples + i, vad->block);
+	if (i < len)
+		vad_part(vad, samples + i, len - i, &keep);
+	return len;
+}
+
+/* Analyze len interleaved samples and drop those which are not
+ * speech, moving the rest to the start of the buffer, so that
+ * a transcode can write just the speech. The samples of a block
+ * which is not complete yet are kept or dropped as those before
+ * them were. Return the number of samples kept, or -1 on error. */
+ssize_t
+au_vad_filter(AUVAD *vad, int16_t *samples, size_t len)
+{
+	size_t i = 0, n, kept = 0;
+	int keep;
+	if (vad == NULL || samples == NULL)
+		return -1;
+	if (vad->npart && (i = vad_part(vad, samples, len, &keep)) && keep)
+		kept = i;
+	for (; i < len; i += n) {
+		if (len - i >= vad->block) {
+			n = vad->block;
+			keep = vad_block(vad, samples + i, n);
+		} else {
+			n = vad_part(vad, samples + i, len - i, &keep);
+		}
+		if (keep) {
+			if (kept != i)
+				memmove(samples + kept, samples + i,
+					n * sizeof(int16_t));
+			kept += n;
+		}
+	}
+	return kept;
+}
+
+/* Analyze what there is of a partial block, and close
+ * the segment of speech we are in, if any,
+ * once there is no more input. */
+void
+au_vad_end(AUVAD *vad)
+{
+	if (vad == NULL)
+		return;
+	if (vad->npart) {
+		vad_block(vad, vad->part, vad->npart);
+		vad->npart = 0;
+	}
+	if (vad->speech)
+		vad_push(vad);
+}
+
+/* Get the next finished segment of speech.
+ * Return 1 if there was one, 0 if there are no more. */
+int
+au_vad_segment(AUVAD *vad, AUSEG *seg)
+{
+	if (vad == NULL || seg == NULL || vad->head == vad->nsegs)
+		return 0;
+	*seg = vad->segs[vad->head++];
+	return 1;
+}
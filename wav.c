@@ -1,44 +1,253 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <string.h>
 #include <err.h>
 
 #include "audio.h"
 #include "wav.h"
 
-/* Read a WAV header from an open file and fill AUINFO accordingly.
+/* Microsoft's RIFF WAVE. All numbers are little-endian.
+ * The file is a RIFF chunk of type WAVE containing subchunks;
+ * we write a 'fmt ' chunk describing the format and a 'data' chunk
+ * with the samples. Both the RIFF chunk and the data chunk carry
+ * their 32 bit length, which is only known at the end; au_close()
+ * fixes them, and so do the checkpoints of au_checkpoint(). */
+
+#define WAV_HDRSIZE	44
+
+#define WAV_PCM		0x0001
+#define WAV_FLOAT	0x0003
+#define WAV_EXTENSIBLE	0xfffe
+
+static uint16_t
+rd16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] <<  0) | ((uint32_t)p[1] <<  8)
+	     | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void
+wr16(unsigned char *p, uint16_t u)
+{
+	p[0] = u >> 0;
+	p[1] = u >> 8;
+}
+
+static void
+wr32(unsigned char *p, uint32_t u)
+{
+	p[0] = u >>  0;
+	p[1] = u >>  8;
+	p[2] = u >> 16;
+	p[3] = u >> 24;
+}
+
+static int
+rdall(int fd, void *buf, size_t len)
+{
+	ssize_t r;
+	size_t tot = 0;
+	while (tot < len) {
+		if ((r = read(fd, (char*)buf + tot, len - tot)) <= 0)
+			return -1;
+		tot += r;
+	}
+	return 0;
+}
+
+/* Skip a chunk we do not care about; the file might not be seekable. */
+static int
+skip(int fd, uint32_t len)
+{
+	unsigned char buf[1024];
+	if (lseek(fd, len, SEEK_CUR) != -1)
+		return 0;
+	while (len) {
+		if (rdall(fd, buf, len < sizeof(buf) ? len : sizeof(buf)))
+			return -1;
+		len -= len < sizeof(buf) ? len : sizeof(buf);
+	}
+	return 0;
+}
+
+/* Read a WAV header from an open file and fill AUINFO accordingly,
+ * leaving the file positioned at the first sample.
  * This is only done during au_open() so we don't seek there and back.
+ * Values already present in AUINFO must agree with it. If the data size
+ * is not filled in, as when the recording did not finish,
+ * the data are taken to go up to the end of the file.
  * Return 0 for success, -1 on error. */
 int
 wav_read_hdr(int fd, AUINFO* info)
 {
-	struct wavhdr hdr;
+	unsigned char buf[40];
+	uint32_t size, srate = 0, encoding = 0;
+	uint64_t frames;
+	uint16_t format, chans = 0, bits = 0;
+	struct stat sb;
+	off_t pos;
+
 	if (NULL == info)
 		return -1;
-	/* FIXME */
-	read(fd, &hdr, sizeof(struct wavhdr));
+	if (rdall(fd, buf, 12)
+	|| memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) {
+		warnx("Not a WAV file");
+		return -1;
+	}
+	for (;;) {
+		if (rdall(fd, buf, 8)) {
+			warnx("No data in WAV file");
+			return -1;
+		}
+		size = rd32(buf + 4);
+		if (0 == memcmp(buf, "fmt ", 4)) {
+			if (size < 16 || rdall(fd, buf, size < 40 ? size : 40))
+				return -1;
+			if (size > 40 && skip(fd, size - 40))
+				return -1;
+			format = rd16(buf);
+			if (format == WAV_EXTENSIBLE && size >= 26)
+				format = rd16(buf + 24);
+			chans = rd16(buf + 2);
+			srate = rd32(buf + 4);
+			bits  = rd16(buf + 14);
+			if (chans == 0 || bits == 0 || bits % 8
+			|| rd16(buf + 12) != chans * bits / 8) {
+				warnx("Bad format of WAV data");
+				return -1;
+			}
+			encoding = AU_ENCTYPE_PCM | bits;
+			if (format == WAV_FLOAT && bits == 32) {
+				encoding |= AU_ENCODING_FLOAT | AU_ORDER_LE;
+			} else if (format == WAV_PCM && bits == 8) {
+				encoding |= AU_ENCODING_UNSIGNED;
+			} else if (format == WAV_PCM) {
+				encoding |= AU_ENCODING_SIGNED | AU_ORDER_LE;
+			} else {
+				warnx("Unsupported WAV format 0x%04x", format);
+				return -1;
+			}
+		} else if (0 == memcmp(buf, "data", 4)) {
+			break;
+		} else if (skip(fd, size + (size & 1))) {
+			return -1;
+		}
+	}
+	if (encoding == 0) {
+		warnx("No description of the WAV data");
+		return -1;
+	}
+	frames = size / (chans * bits / 8);
+	if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode)
+	&& (pos = lseek(fd, 0, SEEK_CUR)) != -1
+	&& (size == 0 || pos + size > sb.st_size))
+		frames = (sb.st_size - pos) / (chans * bits / 8);
+
+	/* The header says what the data are. */
+	if ((info->srate && info->srate != srate)
+	||  (info->channels && info->channels != chans)
+	||  (info->encoding && info->encoding != encoding)) {
+		warnx("The WAV file is not of the format given");
+		return -1;
+	}
+	info->srate = srate;
+	info->channels = chans;
+	info->encoding = encoding;
+	info->frames = frames;
+	info->samples = frames * chans;
+	info->seconds = srate ? (double)frames / srate : 0;
 	return 0;
 }
 
-/* Write a WAV header at the start of an open file as per AUINFO.
- * Seek there and back, so that subsequent samples are written correctly.
+/* Make a WAV header as per AUINFO in buf, of size bytes,
+ * with the sizes of the data as given by info->samples.
+ * Return the length of the header, or -1 on error. */
+ssize_t
+wav_make_hdr(AUINFO* info, unsigned char *hdr, size_t hdrsize)
+{
+	uint32_t bits, size;
+	uint64_t len;
+	int ok;
+
+	if (NULL == info || hdrsize < WAV_HDRSIZE)
+		return -1;
+	bits = info->encoding & AU_BITSIZE_MASK;
+	switch (info->encoding & (AU_ENCODING_MASK | AU_ORDER_MASK)) {
+		case AU_ENCODING_UNSIGNED | AU_ORDER_NONE:
+			ok = bits == 8;
+			break;
+		case AU_ENCODING_SIGNED | AU_ORDER_LE:
+			ok = bits > 8;
+			break;
+		case AU_ENCODING_FLOAT | AU_ORDER_LE:
+			ok = bits == 32;
+			break;
+		default:
+			ok = 0;
+			break;
+	}
+	if (!ok) {
+		warnx("WAV cannot store this encoding");
+		return -1;
+	}
+	if ((uint64_t)info->srate * info->channels * bits / 8 > UINT32_MAX
+	||  info->channels * bits / 8 > UINT16_MAX) {
+		warnx("WAV cannot store %u channels at %u Hz",
+			info->channels, info->srate);
+		return -1;
+	}
+	len = (uint64_t)info->samples * (bits / 8);
+	size = len > UINT32_MAX - 36 ? UINT32_MAX - 36 : len;
+
+	memcpy(hdr, "RIFF", 4);
+	wr32(hdr + 4, 36 + size);
+	memcpy(hdr + 8, "WAVE", 4);
+	memcpy(hdr + 12, "fmt ", 4);
+	wr32(hdr + 16, 16);
+	wr16(hdr + 20, (info->encoding & AU_ENCODING_MASK)
+		== AU_ENCODING_FLOAT ? WAV_FLOAT : WAV_PCM);
+	wr16(hdr + 22, info->channels);
+	wr32(hdr + 24, info->srate);
+	wr32(hdr + 28, info->srate * info->channels * bits / 8);
+	wr16(hdr + 32, info->channels * bits / 8);
+	wr16(hdr + 34, bits);
+	memcpy(hdr + 36, "data", 4);
+	wr32(hdr + 40, size);
+	return WAV_HDRSIZE;
+}
+
+/* Write a WAV header as per AUINFO. At the start of the file,
+ * the header is simply written; later, it is rewritten in place
+ * with a single pwrite(), leaving the position in the file as it was,
+ * so that subsequent samples are written correctly.
  * Return 0 for success, -1 on error. */
 int
 wav_write_hdr(int fd, AUINFO* info)
 {
+	unsigned char hdr[WAV_HDRSIZE];
 	off_t pos;
-	struct wavhdr hdr;
-	if (NULL == info)
-		return -1;
-	if (-1 == (pos = lseek(fd, 0, SEEK_CUR)))
-		return -1;
-	if (-1 == lseek(fd, 0, SEEK_SET))
+
+	if (wav_make_hdr(info, hdr, sizeof(hdr)) == -1)
 		return -1;
-	/* FIXME */
-	read(fd, &hdr, sizeof(struct wavhdr));
-	if (-1 == lseek(fd, pos, SEEK_SET))
+	if ((pos = lseek(fd, 0, SEEK_CUR)) <= 0) {
+		if (write(fd, hdr, sizeof(hdr)) != sizeof(hdr))
+			return -1;
+	} else if (pwrite(fd, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
 		return -1;
+	}
 	return 0;
 }
 
+static const AUHDR wav_hdr = { wav_read_hdr, wav_write_hdr, wav_make_hdr };
+
 int
 wav_init(AUFILE *file)
 {
@@ -48,7 +257,6 @@ wav_init(AUFILE *file)
 		warnx("Will not intitialize non WAV file as WAV");
 		return -1;
 	}
-	file->au_read_hdr = wav_read_hdr;
-	file->au_write_hdr = wav_write_hdr;
+	file->hdr = &wav_hdr;
 	return 0;
 }
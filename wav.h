@@ -3,10 +3,6 @@
 
 #include "audio.h"
 
-struct wavhdr {
-	char	fmt[4];
-};
-
 int wav_init(AUFILE *);
 
 #endif